@@ -0,0 +1,52 @@
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+#include <string.h>
+
+/// borrows of array cells, meant for range stacks (-DSB_RANGE_STACKS) which
+/// track every byte of a borrow or access, per byte stacks only track the
+/// first byte of arr
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut arr = [0; 4];
+  int arr[4] = {0, 0, 0, 0};
+  NEW_LOCAL(arr);
+
+  // let (l, r) = arr.split_at_mut(2);
+  // let x = &mut l[1];
+  USE2_LOCAL(arr[1]);
+  int *x = &arr[1];
+  UNIQUE_FROM_LOCAL(x, arr[1]);
+
+  // let y = &mut r[0];
+  USE2_LOCAL(arr[2]);
+  int *y = &arr[2];
+  UNIQUE_FROM_LOCAL(y, arr[2]);
+
+  // borrows of disjoint cells can be interleaved
+  // *x = 1;
+  USE2(x);
+  *x = 1;
+
+  // *y = 2;
+  USE2(y);
+  *y = 2;
+
+  // *x = 3;
+  USE2(x);
+  *x = 3;
+
+  // arr = [0; 4];
+  USE2_LOCAL(arr);
+  memset(arr, 0, sizeof(arr));
+
+  // *y = 4;
+  USE2(y); // fail
+  *y = 4;
+
+  return 0;
+}
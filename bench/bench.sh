@@ -0,0 +1,87 @@
+#!/bin/sh
+# Runs CBMC on a set of harnesses in several modes of the model and writes a
+# CSV line per harness and mode with the wall time, peak RSS, number of VCCs
+# remaining after simplification, SAT variables and clauses, decision
+# procedure runtime and verdict, followed by the verdict the harness expects
+# when it records one in a "// expected verdict:" comment, as the harnesses
+# generated by bench/gen.sh do.
+#
+# usage: bench/bench.sh [-o out.csv] [-m "<mode>=<cbmc flags>"]... harness.c...
+#
+# Without -m every harness runs in the exhaustive mode (stacked_borrows.h) and
+# in the demonic mode (-DDEMONIC). The CSV is written to stdout unless -o is
+# given. CBMC, CBMC_FLAGS and TIME, the GNU time binary that measures the peak
+# RSS, can be overridden from the environment. Without GNU time the wall time
+# is measured with date and the peak RSS is reported as "-".
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+CBMC_FLAGS=${CBMC_FLAGS:---pointer-check --bounds-check --slice-formula}
+TIME=${TIME:-/usr/bin/time}
+
+usage() {
+  echo "usage: $0 [-o out.csv] [-m \"<mode>=<cbmc flags>\"]... harness.c..." >&2
+  exit 2
+}
+
+out=
+# modes, one "<mode>=<cbmc flags>" per line
+modes=
+while getopts o:m: opt; do
+  case $opt in
+  o) out=$OPTARG ;;
+  m) modes="$modes$OPTARG
+" ;;
+  *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -lt 1 ]; then
+  usage
+fi
+if [ -z "$modes" ]; then
+  modes="exhaustive=
+demonic=-DDEMONIC
+"
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Runs CBMC with the given extra flags on a harness and prints
+# "<wall seconds> <peak rss kB> <vccs> <variables> <clauses> <seconds> <verdict>".
+run() {
+  if [ -x "$TIME" ]; then
+    # shellcheck disable=SC2086
+    "$TIME" -f '%e %M' -o "$tmp/time" \
+      $CBMC $CBMC_FLAGS $1 "$2" </dev/null >"$tmp/log" 2>&1
+    # GNU time first reports a non-zero exit status on its own line
+    wall_rss=$(tail -n 1 "$tmp/time")
+  else
+    start=$(date +%s.%N)
+    # shellcheck disable=SC2086
+    $CBMC $CBMC_FLAGS $1 "$2" </dev/null >"$tmp/log" 2>&1
+    end=$(date +%s.%N)
+    wall_rss=$(echo "$start $end" | awk '{ printf "%.2f -", $2 - $1 }')
+  fi
+  echo "$wall_rss $(awk -f "$(dirname "$0")/cbmc_stats.awk" "$tmp/log")"
+}
+
+if [ -n "$out" ]; then
+  exec >"$out"
+fi
+
+echo "harness,mode,flags,wall_s,peak_rss_kb,vccs,variables,clauses,solver_s,verdict,expected"
+for harness in "$@"; do
+  expected=$(sed -n 's|^// expected verdict: ||p' "$harness")
+  printf '%s' "$modes" | while IFS= read -r mode; do
+    name=${mode%%=*}
+    flags=${mode#*=}
+    echo "$(basename "$harness" .c) [$name]" >&2
+    run "$flags" "$harness" | {
+      read -r wall rss vccs vars clauses time verdict
+      echo "$(basename "$harness" .c),$name,\"$flags\",$wall,$rss,$vccs,$vars,$clauses,$time,$verdict,${expected:--}"
+    }
+  done
+done
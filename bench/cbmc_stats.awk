@@ -0,0 +1,13 @@
+# Extracts statistics from the output of a CBMC run and prints
+# "<vccs> <variables> <clauses> <solver seconds> <verdict>", "-" standing for
+# a missing statistic and ERROR for a run that did not reach a verdict.
+/remaining after simplification/ { vccs = $4 }
+/ variables, .* clauses/ { vars = $1; clauses = $3 }
+/^Runtime decision procedure:/ { time = $NF; sub(/s$/, "", time) }
+/^VERIFICATION SUCCESSFUL/ { verdict = "SUCCESSFUL" }
+/^VERIFICATION FAILED/ { verdict = "FAILED" }
+END {
+  printf "%s %s %s %s %s\n", (vccs == "" ? "-" : vccs),
+    (vars == "" ? "-" : vars), (clauses == "" ? "-" : clauses),
+    (time == "" ? "-" : time), (verdict == "" ? "ERROR" : verdict)
+}
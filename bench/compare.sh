@@ -0,0 +1,72 @@
+#!/bin/sh
+# Compares formula size and solve time of two or more builds of the model on
+# a set of harnesses.
+#
+# usage: bench/compare.sh "<cbmc flags A>" "<cbmc flags B>"... harness.c...
+#
+# Every argument before the first one ending in .c is a build.
+#
+# For each harness and build prints the number of VCCs remaining after
+# simplification, SAT variables and clauses, decision procedure runtime and
+# verdict. A build whose verdict differs from the verdict of the first build
+# on the same harness is not comparable: its row is marked and the script
+# exits with status 1. CBMC and CBMC_FLAGS can be overridden from the
+# environment.
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+CBMC_FLAGS=${CBMC_FLAGS:---pointer-check --bounds-check --slice-formula}
+
+usage() {
+  echo "usage: $0 \"<cbmc flags A>\" \"<cbmc flags B>\"... harness.c..." >&2
+  exit 2
+}
+
+# builds, one per line
+builds=
+nof_builds=0
+while [ $# -gt 0 ]; do
+  case $1 in
+  *.c) break ;;
+  esac
+  builds="$builds$1
+"
+  nof_builds=$((nof_builds + 1))
+  shift
+done
+if [ "$nof_builds" -lt 2 ] || [ $# -lt 1 ]; then
+  usage
+fi
+
+# Runs CBMC with the given extra flags on a harness and prints
+# "<vccs> <variables> <clauses> <seconds> <verdict>".
+stats() {
+  # shellcheck disable=SC2086
+  $CBMC $CBMC_FLAGS $1 "$2" </dev/null 2>&1 |
+    awk -f "$(dirname "$0")/cbmc_stats.awk"
+}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+printf '%-20s %-28s %6s %10s %10s %10s %s\n' \
+  harness build vccs variables clauses solver_s verdict
+for harness in "$@"; do
+  rm -f "$tmp/baseline"
+  printf '%s' "$builds" | while IFS= read -r flags; do
+    stats "$flags" "$harness" | {
+      read -r vccs vars clauses time verdict
+      if [ ! -f "$tmp/baseline" ]; then
+        echo "$verdict" >"$tmp/baseline"
+      elif [ "$verdict" != "$(cat "$tmp/baseline")" ]; then
+        verdict="$verdict, MISMATCH with $(cat "$tmp/baseline")"
+        touch "$tmp/mismatch"
+      fi
+      printf '%-20s %-28s %6s %10s %10s %10s %s\n' \
+        "$(basename "$harness" .c)" "${flags:-default}" \
+        "$vccs" "$vars" "$clauses" "$time" "$verdict"
+    }
+  done
+done
+[ ! -f "$tmp/mismatch" ]
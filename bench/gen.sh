@@ -0,0 +1,209 @@
+#!/bin/sh
+# Generates an instrumented harness exercising the model at a given scale.
+#
+# usage: bench/gen.sh [-l locations] [-d depth] [-s shared] [-r raw]
+#                     [-k max stack size] [-i] [-f] [-b] > harness.c
+#
+# For each of the locations (default 1) the harness creates a chain of depth
+# (default 1) mutable reborrows, then from the top of the chain shared shared
+# references (default 0) that are read and raw raw pointers (default 0) that
+# are written, then writes down the chain and finally writes the location
+# directly. Shared references come first as reading the top of the chain pops
+# raw pointers. With -i the statements of the locations are interleaved
+# instead of handled one location after the other.
+# With -f a reborrow of the first reference of the first location is appended
+# after the direct write, which is a violation. With -b reborrows use the fused
+# REBORROW_* macros instead of a check followed by a push.
+#
+# The expected verdict is recorded in a "// expected verdict:" comment that
+# bench/bench.sh reports. The stack bound defaults to the deepest stack the
+# harness builds and cannot exceed 127, the largest index of a stack; 8 bit
+# tags are widened when they do not suffice.
+
+set -u
+
+usage() {
+  echo "usage: $0 [-l locations] [-d depth] [-s shared] [-r raw]" \
+    "[-k max stack size] [-i] [-f] [-b]" >&2
+  exit 2
+}
+
+locations=1
+depth=1
+shared=0
+raw=0
+stack_size=
+interleave=false
+fail=false
+fused=false
+while getopts l:d:s:r:k:ifb opt; do
+  case $opt in
+  l) locations=$OPTARG ;;
+  d) depth=$OPTARG ;;
+  s) shared=$OPTARG ;;
+  r) raw=$OPTARG ;;
+  k) stack_size=$OPTARG ;;
+  i) interleave=true ;;
+  f) fail=true ;;
+  b) fused=true ;;
+  *) usage ;;
+  esac
+done
+if [ "$locations" -lt 1 ] || [ "$depth" -lt 1 ]; then
+  usage
+fi
+
+# local item, chain, shared and raw items
+[ -n "$stack_size" ] || stack_size=$((1 + depth + raw + shared))
+if [ "$stack_size" -gt 127 ]; then
+  echo "$0: stacks of $stack_size items do not fit int8_t indices" >&2
+  exit 2
+fi
+tags=$((locations * (1 + depth + shared)))
+
+# Prints the reborrow "<type> <new> = <old>;" as the rule check on old, the
+# declaration and the push, or as the declaration and the fused macro with -b.
+# usage: reborrow <check> <push> <fused> <new> <old> [<check argument>]
+reborrow() {
+  if $fused; then
+    printf '  int32_t *%s = %s;\n' "$4" "$5"
+    printf '  %s(%s, %s);\n' "$3" "$4" "${6:-$5}"
+  else
+    printf '  %s(%s);\n' "$1" "${6:-$5}"
+    printf '  int32_t *%s = %s;\n' "$4" "$5"
+    printf '  %s(%s, %s);\n' "$2" "$4" "${6:-$5}"
+  fi
+}
+
+# Prints the statements of the given phase for location i, one phase per call
+# so that locations can be interleaved phase by phase.
+# Phases: 0 declaration, 1 chain, 2 shared references, 3 shared reads,
+# 4 raw pointers, 5 raw writes, 6 chain writes, 7 direct write.
+phase() {
+  p=$1
+  i=$2
+  top="p${i}_$((depth - 1))"
+  case $p in
+  0)
+    printf '\n  // let mut loc%d = %d;\n' "$i" "$i"
+    printf '  int32_t loc%d = %d;\n' "$i" "$i"
+    printf '  NEW_LOCAL(loc%d);\n' "$i"
+    ;;
+  1)
+    printf '\n  // let p%d_0 = &mut loc%d;\n' "$i" "$i"
+    reborrow USE2_LOCAL UNIQUE_FROM_LOCAL REBORROW_MUT_LOCAL "p${i}_0" \
+      "&loc$i" "loc$i"
+    k=1
+    while [ $k -lt "$depth" ]; do
+      printf '\n  // let p%d_%d = &mut *p%d_%d;\n' "$i" $k "$i" $((k - 1))
+      reborrow USE2 UNIQUE_FROM_REF REBORROW_MUT "p${i}_$k" \
+        "p${i}_$((k - 1))"
+      k=$((k + 1))
+    done
+    ;;
+  2)
+    j=0
+    while [ $j -lt "$shared" ]; do
+      printf '\n  // let s%d_%d = &*%s;\n' "$i" $j "$top"
+      reborrow READ1 SHARED_RO_FROM_REF REBORROW_SHARED "s${i}_$j" "$top"
+      j=$((j + 1))
+    done
+    ;;
+  3)
+    j=0
+    while [ $j -lt "$shared" ]; do
+      printf '\n  // sum += *s%d_%d;\n' "$i" $j
+      printf '  READ1(s%d_%d);\n' "$i" $j
+      printf '  sum += *s%d_%d;\n' "$i" $j
+      j=$((j + 1))
+    done
+    ;;
+  4)
+    j=0
+    while [ $j -lt "$raw" ]; do
+      printf '\n  // let r%d_%d = &mut *%s as *mut i32;\n' "$i" $j "$top"
+      reborrow USE2 SHARED_RW_FROM_REF REBORROW_RAW "r${i}_$j" "$top"
+      j=$((j + 1))
+    done
+    ;;
+  5)
+    j=0
+    while [ $j -lt "$raw" ]; do
+      printf '\n  // unsafe { *r%d_%d += 1; }\n' "$i" $j
+      printf '  USE2(r%d_%d);\n' "$i" $j
+      printf '  *r%d_%d += 1;\n' "$i" $j
+      j=$((j + 1))
+    done
+    ;;
+  6)
+    k=$((depth - 1))
+    while [ $k -ge 0 ]; do
+      printf '\n  // *p%d_%d += 1;\n' "$i" $k
+      printf '  USE2(p%d_%d);\n' "$i" $k
+      printf '  *p%d_%d += 1;\n' "$i" $k
+      k=$((k - 1))
+    done
+    ;;
+  7)
+    printf '\n  // loc%d += sum;\n' "$i"
+    printf '  USE2_LOCAL(loc%d);\n' "$i"
+    printf '  loc%d += sum;\n' "$i"
+    ;;
+  esac
+}
+
+if $fail; then
+  verdict=FAILED
+else
+  verdict=SUCCESSFUL
+fi
+
+printf '// generated by bench/gen.sh %s\n' "$*"
+printf '// expected verdict: %s\n' "$verdict"
+if [ "$tags" -ge 127 ]; then
+  printf '#ifndef SB_TAG_BITS\n#define SB_TAG_BITS 16\n#endif\n'
+fi
+printf '#ifdef DEMONIC\n#include "stacked_borrows_demonic.h"\n#else\n'
+printf '#include "stacked_borrows.h"\n#endif\n\n'
+printf '/// %d locations, reborrow chains of depth %d, %d raw pointers and %d\n' \
+  "$locations" "$depth" "$raw" "$shared"
+printf '/// shared references per location\n'
+printf 'int main() {\n'
+printf '  SB_INIT(true, %d);\n' "$stack_size"
+printf '\n  int32_t sum = 0;\n'
+
+p=0
+while [ $p -le 7 ]; do
+  if $interleave; then
+    i=0
+    while [ $i -lt "$locations" ]; do
+      phase $p $i
+      i=$((i + 1))
+    done
+  fi
+  p=$((p + 1))
+done
+if ! $interleave; then
+  i=0
+  while [ $i -lt "$locations" ]; do
+    p=0
+    while [ $p -le 7 ]; do
+      phase $p $i
+      p=$((p + 1))
+    done
+    i=$((i + 1))
+  done
+fi
+
+if $fail; then
+  printf '\n  // let q = &mut *p0_0;\n'
+  if $fused; then
+    printf '  int32_t *q = p0_0;\n'
+    printf '  REBORROW_MUT(q, p0_0); // fail\n'
+  else
+    printf '  USE2(p0_0); // fail\n'
+    printf '  int32_t *q = p0_0;\n'
+    printf '  UNIQUE_FROM_REF(q, p0_0);\n'
+  fi
+fi
+printf '\n  return 0;\n}\n'
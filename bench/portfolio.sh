@@ -0,0 +1,159 @@
+#!/bin/sh
+# Runs several CBMC configurations on a harness in parallel and returns the
+# first final verdict, killing the other runs.
+#
+# usage: bench/portfolio.sh [-j jobs] [-v] [-c "<name>=<cbmc flags>"]...
+#                           harness.c
+#
+# Exhaustive configurations are sound and complete for the harness, so any of
+# their verdicts is final. Demonic configurations, those compiled with
+# -DDEMONIC, miss violations that need several locations, fields or whole
+# objects to be tracked, e.g. struct_fail.c, so only their FAILED verdicts are
+# final and their SUCCESSFUL verdicts are ignored. Without -c the portfolio
+# combines the exhaustive
+# and demonic headers, symbolic and concrete stack sizes (SB_FORCE_SYMSIZE),
+# MiniSat and CaDiCaL, with and without --slice-formula. At most jobs
+# configurations (default: the number of cores) run at a time, the next one
+# starting when one ends without a verdict. Prints
+# "<harness>: <verdict> by <name> in <seconds>s", with -v after the output of
+# the winning run, and exits with the status of that run like CBMC: 0 when
+# successful, 10 when failed, 6 when no configuration reached a final verdict.
+# CBMC and CBMC_FLAGS can be overridden from the environment.
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+CBMC_FLAGS=${CBMC_FLAGS:---pointer-check --bounds-check}
+
+usage() {
+  echo "usage: $0 [-j jobs] [-v] [-c \"<name>=<cbmc flags>\"]... harness.c" >&2
+  exit 2
+}
+
+jobs=$(nproc 2>/dev/null || echo 4)
+verbose=false
+# configurations, one "<name>=<cbmc flags>" per line
+configs=
+while getopts j:vc: opt; do
+  case $opt in
+  j) jobs=$OPTARG ;;
+  v) verbose=true ;;
+  c) configs="$configs$OPTARG
+" ;;
+  *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 1 ]; then
+  usage
+fi
+harness=$1
+if [ -z "$configs" ]; then
+  configs="exhaustive=--slice-formula
+demonic=-DDEMONIC --slice-formula
+exhaustive_concrete=-DSB_FORCE_SYMSIZE=0 --slice-formula
+demonic_concrete=-DDEMONIC -DSB_FORCE_SYMSIZE=0 --slice-formula
+exhaustive_cadical=--slice-formula --sat-solver cadical
+demonic_cadical=-DDEMONIC --slice-formula --sat-solver cadical
+exhaustive_unsliced=
+demonic_unsliced=-DDEMONIC
+"
+fi
+
+# runs CBMC in its own process group when possible, so that killing a run
+# also kills the SMT solver it spawned
+setsid=
+if command -v setsid >/dev/null; then
+  setsid=setsid
+fi
+
+tmp=$(mktemp -d)
+# Kills the runs still going on: the shell of each run, then the process
+# group of its CBMC.
+cleanup() {
+  for dir in "$tmp"/*/; do
+    [ -f "$dir/status" ] && continue
+    [ -f "$dir/shell" ] && kill "$(cat "$dir/shell")" 2>/dev/null
+    if [ -f "$dir/pid" ]; then
+      pid=$(cat "$dir/pid")
+      kill -- "-$pid" 2>/dev/null || kill "$pid" 2>/dev/null
+    fi
+  done
+  rm -rf "$tmp"
+}
+trap cleanup EXIT
+trap 'exit 130' INT TERM
+
+# Starts configuration number i, whose status file appears when it ends.
+launch() {
+  i=$1
+  line=$(printf '%s' "$configs" | sed -n "${i}p")
+  mkdir "$tmp/$i"
+  echo "${line%%=*}" >"$tmp/$i/name"
+  case " ${line#*=} " in
+  *" -DDEMONIC "*) touch "$tmp/$i/demonic" ;;
+  esac
+  (
+    # shellcheck disable=SC2086
+    $setsid $CBMC $CBMC_FLAGS ${line#*=} "$harness" </dev/null \
+      >"$tmp/$i/log" 2>&1 &
+    echo $! >"$tmp/$i/pid"
+    wait $!
+    echo $? >"$tmp/$i/status.tmp"
+    mv "$tmp/$i/status.tmp" "$tmp/$i/status"
+  ) &
+  echo $! >"$tmp/$i/shell"
+}
+
+nof_configs=$(printf '%s' "$configs" | wc -l)
+start=$(date +%s.%N)
+next=1
+running=0
+winner=
+while [ -z "$winner" ]; do
+  while [ $running -lt "$jobs" ] && [ $next -le "$nof_configs" ]; do
+    launch $next
+    next=$((next + 1))
+    running=$((running + 1))
+  done
+  [ $running -eq 0 ] && break
+  sleep 0.1
+  for dir in "$tmp"/*/; do
+    [ -f "$dir/status" ] && [ ! -f "$dir/done" ] || continue
+    touch "$dir/done"
+    running=$((running - 1))
+    case $(cat "$dir/status") in
+    10)
+      winner=$dir
+      break
+      ;;
+    0)
+      # a demonic run may have missed a violation
+      if [ ! -f "$dir/demonic" ]; then
+        winner=$dir
+        break
+      fi
+      ;;
+    esac
+  done
+done
+end=$(date +%s.%N)
+seconds=$(echo "$start $end" | awk '{ printf "%.2f", $2 - $1 }')
+
+if [ -z "$winner" ]; then
+  echo "$(basename "$harness" .c): ERROR, no configuration reached a final" \
+    "verdict in ${seconds}s"
+  exit 6
+fi
+status=$(cat "$winner/status")
+if $verbose; then
+  cat "$winner/log"
+fi
+if [ "$status" -eq 0 ]; then
+  verdict=SUCCESSFUL
+else
+  verdict=FAILED
+fi
+echo "$(basename "$harness" .c): $verdict by $(cat "$winner/name")" \
+  "in ${seconds}s"
+exit "$status"
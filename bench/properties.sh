@@ -0,0 +1,85 @@
+#!/bin/sh
+# Verifies the borrow checks of a harness one property at a time, in
+# parallel CBMC processes.
+#
+# usage: bench/properties.sh [-j jobs] [-r] harness.c
+#
+# The properties are listed with --show-properties and each one is verified
+# by its own CBMC run with --property, so that every formula only holds what
+# the property needs. Every property is checked unless -r is given, in which
+# case only assertions are: the USE1, USE2 and READ1 rule checks and the
+# bounds the model asserts, e.g. on stack sizes and tags, but not the pointer
+# and bounds checks added by CBMC. At most jobs runs (default: the number of
+# cores) go on at a time. Prints "<property> <description>: <verdict>" per
+# property and exits like CBMC: 0 when all properties hold, 10 when one fails,
+# 6 when a run did not reach a verdict. CBMC and CBMC_FLAGS can be overridden
+# from the environment.
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+CBMC_FLAGS=${CBMC_FLAGS:---pointer-check --bounds-check --slice-formula}
+
+usage() {
+  echo "usage: $0 [-j jobs] [-r] harness.c" >&2
+  exit 2
+}
+
+jobs=$(nproc 2>/dev/null || echo 4)
+rules=false
+while getopts j:r opt; do
+  case $opt in
+  j) jobs=$OPTARG ;;
+  r) rules=true ;;
+  *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 1 ]; then
+  usage
+fi
+harness=$1
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# "<property>\t<description>" per property, the description being the line
+# after the location of the property
+# shellcheck disable=SC2086
+$CBMC $CBMC_FLAGS --show-properties "$harness" </dev/null 2>&1 |
+  awk '/^Property / { name = $2; sub(/:$/, "", name); line = 0; next }
+    name != "" && ++line == 2 { sub(/^ +/, ""); print name "\t" $0 }' \
+    >"$tmp/all"
+if $rules; then
+  # assert and __CPROVER_assert properties are named <function>.assertion.<n>
+  grep -E '^[^	]*\.assertion\.[0-9]+	' "$tmp/all" >"$tmp/properties"
+else
+  cp "$tmp/all" "$tmp/properties"
+fi
+if [ ! -s "$tmp/properties" ]; then
+  echo "$(basename "$harness" .c): no property to check" >&2
+  exit 6
+fi
+
+export CBMC CBMC_FLAGS harness tmp
+cut -f 1 "$tmp/properties" | xargs -P "$jobs" -n 1 sh -c '
+  # shellcheck disable=SC2086
+  $CBMC $CBMC_FLAGS --property "$1" "$harness" </dev/null >/dev/null 2>&1
+  echo $? >"$tmp/$1.status"' sh
+
+status=0
+while IFS="	" read -r name description; do
+  case $(cat "$tmp/$name.status") in
+  0) verdict=SUCCESSFUL ;;
+  10)
+    verdict=FAILED
+    status=10
+    ;;
+  *)
+    verdict=ERROR
+    [ $status -eq 10 ] || status=6
+    ;;
+  esac
+  echo "$name $description: $verdict"
+done <"$tmp/properties"
+exit $status
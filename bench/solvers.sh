@@ -0,0 +1,68 @@
+#!/bin/sh
+# Runs CBMC on a set of harnesses with each locally available decision
+# procedure and reports the fastest one per harness.
+#
+# usage: bench/solvers.sh [-o out.csv] [-f "<cbmc flags>"] harness.c...
+#
+# The backends are MiniSat (the default), CaDiCaL when CBMC supports
+# --sat-solver or a cadical binary is installed, Z3 and CVC5 through --smt2
+# when their binaries are installed, and MiniSat with --refine-arrays. The
+# flags given with -f, e.g. -DDEMONIC, are added to every run. The runs are
+# written by bench/bench.sh to the CSV file given with -o, then the fastest
+# backend of each harness by wall time is printed, ignoring runs that did not
+# reach a verdict. CBMC, CBMC_FLAGS and TIME are passed on to bench/bench.sh.
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+
+usage() {
+  echo "usage: $0 [-o out.csv] [-f \"<cbmc flags>\"] harness.c..." >&2
+  exit 2
+}
+
+out=
+flags=
+while getopts o:f: opt; do
+  case $opt in
+  o) out=$OPTARG ;;
+  f) flags=$OPTARG ;;
+  *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -lt 1 ]; then
+  usage
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+[ -n "$out" ] || out=$tmp/solvers.csv
+
+# modes are prepended to the harnesses, last backend first
+set -- -m "refine_arrays=${flags:+$flags }--refine-arrays" "$@"
+if command -v cvc5 >/dev/null; then
+  set -- -m "cvc5=${flags:+$flags }--smt2 --cvc5" "$@"
+fi
+if command -v z3 >/dev/null; then
+  set -- -m "z3=${flags:+$flags }--smt2 --z3" "$@"
+fi
+if $CBMC --help 2>&1 | grep -q -- '--sat-solver'; then
+  set -- -m "cadical=${flags:+$flags }--sat-solver cadical" "$@"
+elif command -v cadical >/dev/null; then
+  set -- -m "cadical=${flags:+$flags }--external-sat-solver cadical" "$@"
+fi
+set -- -m "minisat=$flags" "$@"
+
+sh "$(dirname "$0")/bench.sh" -o "$out" "$@" || exit
+
+# harness,mode,flags,wall_s,...,verdict,expected
+awk -F, 'NR > 1 && $10 != "ERROR" && $4 != "-" {
+  if (!($1 in best) || $4 + 0 < best[$1] + 0) { best[$1] = $4; mode[$1] = $2 }
+  if (!($1 in order)) order[$1] = n++
+}
+END {
+  for (h in order) names[order[h]] = h
+  for (i = 0; i < n; i++)
+    printf "%s: %s (%ss)\n", names[i], mode[names[i]], best[names[i]]
+}' "$out"
@@ -0,0 +1,43 @@
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// shared reborrows in a loop, the stack overflows unless the tags of dead
+/// references are collected (-DSB_TAG_GC) or SharedRO runs are compressed
+/// (-DSB_RO_SETS)
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 42;
+  int local = 42;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  int sum = 0;
+  for (int i = 0; i < 16; i++) {
+    // let shared = &*x;
+    READ1(x);
+    int *shared = x;
+    SHARED_RO_FROM_REF(shared, x);
+
+    // sum += *shared;
+    READ1(shared);
+    sum += *shared;
+
+    // end of the lifetime of shared
+    STORAGE_DEAD(shared);
+    SB_GC();
+  }
+
+  // *x += sum;
+  USE2(x);
+  *x += sum;
+
+  return 0;
+}
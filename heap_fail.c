@@ -0,0 +1,54 @@
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a local and two heap buffers, the violation is on the second buffer,
+/// compile with -DHYBRID to track the heap in hybrid mode
+int main() {
+#ifdef HYBRID
+  SB_INIT_HYBRID(true, 16);
+#else
+  SB_INIT(true, 16);
+#endif
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let buf1 = Box::new(5);
+  int32_t *buf1 = malloc(sizeof(int32_t) * 4);
+  NEW_DYNAMIC(buf1);
+  USE2(buf1);
+  *buf1 = 5;
+
+  // let buf2 = Box::new(0);
+  int32_t *buf2 = malloc(sizeof(int32_t) * 4);
+  NEW_DYNAMIC(buf2);
+
+  // let x = &mut *buf2;
+  USE2(buf2);
+  int32_t *x = buf2;
+  UNIQUE_FROM_REF(x, buf2);
+
+  // *buf2 = 1;
+  USE2(buf2); // pops x
+  *buf2 = 1;
+
+  // let l = &mut local;
+  USE2_LOCAL(local);
+  int32_t *l = &local;
+  UNIQUE_FROM_LOCAL(l, local);
+
+  // *l = *buf1;
+  READ1(buf1);
+  USE2(l);
+  *l = *buf1;
+
+  // *x = 2;
+  USE2(x); // fail
+  *x = 2;
+
+  return 0;
+}
@@ -0,0 +1,35 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing through a reference invalidates its shared reborrows,
+/// miri tests/fail/stacked_borrows/alias_through_mutation.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 42;
+  int32_t local = 42;
+  NEW_LOCAL(local);
+
+  // let target = &mut local;
+  USE2_LOCAL(local);
+  int32_t *target = &local;
+  UNIQUE_FROM_LOCAL(target, local);
+
+  // let target_alias = &*target;
+  READ1(target);
+  int32_t *target_alias = target;
+  SHARED_RO_FROM_REF(target_alias, target);
+
+  // *target = 13;
+  USE2(target);
+  *target = 13;
+
+  // let _val = *target_alias;
+  READ1(target_alias); // fail
+  int32_t val = *target_alias;
+  return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Checks the verdict of every harness of the corpus against the verdict
+# recorded in its "// expected verdict:" comment.
+#
+# usage: miri/check.sh [-n] [-d dir] [flags]...
+#
+# The harnesses are those of miri/, or with -d those of dir, e.g. generated by
+# bench/gen.sh. Each harness is analysed by CBMC with the given extra flags, or
+# with -n compiled with $CC and the flags and executed natively. Both exit
+# with status 10 on a violation. Prints one line per harness and exits with
+# status 1 if any verdict differs from the expected one. CBMC, CBMC_FLAGS, CC
+# and NATIVE_CFLAGS can be overridden from the environment.
+
+set -u
+
+CBMC=${CBMC:-cbmc}
+CBMC_FLAGS=${CBMC_FLAGS:---pointer-check --bounds-check --slice-formula}
+CC=${CC:-cc}
+NATIVE_CFLAGS=${NATIVE_CFLAGS:--DSB_NATIVE -O2}
+
+native=false
+if [ "${1:-}" = -n ]; then
+  native=true
+  shift
+fi
+
+root=$(dirname "$0")/..
+dir=$(dirname "$0")
+if [ "${1:-}" = -d ] && [ $# -ge 2 ]; then
+  dir=$2
+  shift 2
+fi
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+mismatches=0
+for harness in "$dir"/*.c; do
+  name=$(basename "$harness" .c)
+  expected=$(sed -n 's|^// expected verdict: ||p' "$harness")
+  if $native; then
+    # shellcheck disable=SC2086
+    if ! $CC $NATIVE_CFLAGS "$@" -I "$root" -o "$tmp/$name" "$harness"; then
+      echo "$name: does not compile"
+      mismatches=$((mismatches + 1))
+      continue
+    fi
+    "$tmp/$name" >/dev/null 2>&1
+  else
+    # shellcheck disable=SC2086
+    $CBMC $CBMC_FLAGS "$@" -I "$root" "$harness" </dev/null >/dev/null 2>&1
+  fi
+  case $? in
+  0) verdict=SUCCESSFUL ;;
+  10) verdict=FAILED ;;
+  *) verdict=ERROR ;;
+  esac
+  if [ "$verdict" = "$expected" ]; then
+    echo "$name: $verdict"
+  else
+    echo "$name: $verdict, expected $expected"
+    mismatches=$((mismatches + 1))
+  fi
+done
+[ $mismatches -eq 0 ]
@@ -0,0 +1,37 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing through a const raw pointer cast back to mut,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs direct_mut_to_const_raw
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int32_t *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  // let y: *const i32 = x;
+  USE2(x);
+  int32_t *y = x;
+  SHARED_RW_FROM_REF(y, x);
+
+  // unsafe { *(y as *mut i32) = 1; }
+  int32_t *y_mut = y;
+  TRANSMUTE_REF(y_mut, y);
+  USE2(y_mut);
+  *y_mut = 1;
+
+  // assert_eq!(*x, 1);
+  READ1(x);
+  assert(*x == 1);
+  return 0;
+}
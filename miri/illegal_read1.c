@@ -0,0 +1,35 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// reading through a raw pointer invalidates the mutable reborrows above it,
+/// miri tests/fail/stacked_borrows/illegal_read1.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 15;
+  int32_t x = 15;
+  NEW_LOCAL(x);
+
+  // let xraw = &mut x as *mut i32;
+  USE2_LOCAL(x);
+  int32_t *xraw = &x;
+  SHARED_RW_FROM_LOCAL(xraw, x);
+
+  // let xref = unsafe { &mut *xraw };
+  USE2(xraw);
+  int32_t *xref = xraw;
+  UNIQUE_FROM_REF(xref, xraw);
+
+  // callee(xraw): let _val = unsafe { *xraw };
+  READ1(xraw);
+  int32_t val1 = *xraw;
+
+  // let _val = *xref;
+  READ1(xref); // fail
+  int32_t val2 = *xref;
+  return 0;
+}
@@ -0,0 +1,36 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a mutable reborrow of a raw pointer invalidates its sibling,
+/// miri tests/fail/stacked_borrows/illegal_read2.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 15;
+  int32_t x = 15;
+  NEW_LOCAL(x);
+
+  // let xraw = &mut x as *mut i32;
+  USE2_LOCAL(x);
+  int32_t *xraw = &x;
+  SHARED_RW_FROM_LOCAL(xraw, x);
+
+  // let xref = unsafe { &mut *xraw };
+  USE2(xraw);
+  int32_t *xref = xraw;
+  UNIQUE_FROM_REF(xref, xraw);
+
+  // callee(xraw): let _xref2 = unsafe { &mut *xraw };
+  USE2(xraw);
+  int32_t *xref2 = xraw;
+  UNIQUE_FROM_REF(xref2, xraw);
+
+  // let _val = *xref;
+  READ1(xref); // fail
+  int32_t val = *xref;
+  return 0;
+}
@@ -0,0 +1,41 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a shared reborrow does not bring back an invalidated raw pointer,
+/// miri tests/fail/stacked_borrows/illegal_read6.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int32_t *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  // let raw = x as *mut i32;
+  USE2(x);
+  int32_t *raw = x;
+  SHARED_RW_FROM_REF(raw, x);
+
+  // let x = &mut *x;
+  USE2(x);
+  int32_t *x2 = x;
+  UNIQUE_FROM_REF(x2, x);
+
+  // let _y = &*x;
+  READ1(x2);
+  int32_t *y = x2;
+  SHARED_RO_FROM_REF(y, x2);
+
+  // let _val = unsafe { *raw };
+  READ1(raw); // fail
+  int32_t val = *raw;
+  return 0;
+}
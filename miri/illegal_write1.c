@@ -0,0 +1,36 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing through a raw pointer cast from a shared reference,
+/// miri tests/fail/stacked_borrows/illegal_write1.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let target = Box::new(42);
+  int32_t *target = malloc(sizeof(int32_t));
+  NEW_DYNAMIC(target);
+  USE2(target);
+  *target = 42;
+
+  // let target_ref = &*target;
+  READ1(target);
+  int32_t *target_ref = target;
+  SHARED_RO_FROM_REF(target_ref, target);
+
+  // let target_ptr = target_ref as *const i32 as *mut i32;
+  int32_t *target_ptr = target_ref;
+  TRANSMUTE_REF(target_ptr, target_ref);
+
+  // unsafe { *target_ptr = 13 };
+  USE2(target_ptr); // fail
+  *target_ptr = 13;
+
+  // let _val = *target;
+  READ1(target);
+  int32_t val = *target;
+  return 0;
+}
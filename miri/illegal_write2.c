@@ -0,0 +1,36 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a mutable reborrow invalidates the raw pointers created before it,
+/// miri tests/fail/stacked_borrows/illegal_write2.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 42;
+  int32_t local = 42;
+  NEW_LOCAL(local);
+
+  // let target = &mut local;
+  USE2_LOCAL(local);
+  int32_t *target = &local;
+  UNIQUE_FROM_LOCAL(target, local);
+
+  // let target2 = target as *mut i32;
+  USE2(target);
+  int32_t *target2 = target;
+  SHARED_RW_FROM_REF(target2, target);
+
+  // drop(&mut *target);
+  USE2(target);
+  int32_t *dropped = target;
+  UNIQUE_FROM_REF(dropped, target);
+
+  // unsafe { *target2 = 13 };
+  USE2(target2); // fail
+  *target2 = 13;
+  return 0;
+}
@@ -0,0 +1,34 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing a local through a raw pointer cast from a shared reference,
+/// miri tests/fail/stacked_borrows/illegal_write3.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let target = 42;
+  int32_t target = 42;
+  NEW_LOCAL(target);
+
+  // let r#ref = &target;
+  READ1_LOCAL(target);
+  int32_t *ref = &target;
+  SHARED_RO_FROM_LOCAL(ref, target);
+
+  // let ptr = r#ref as *const i32 as *mut i32;
+  int32_t *ptr = ref;
+  TRANSMUTE_REF(ptr, ref);
+
+  // unsafe { *ptr = 42 };
+  USE2(ptr); // fail
+  *ptr = 42;
+
+  // let _val = *r#ref;
+  READ1(ref);
+  int32_t val = *ref;
+  return 0;
+}
@@ -0,0 +1,35 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing a local invalidates the references derived from its raw pointers,
+/// miri tests/fail/stacked_borrows/illegal_write5.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut target = 42;
+  int32_t target = 42;
+  NEW_LOCAL(target);
+
+  // let target2 = &mut target as *mut i32;
+  USE2_LOCAL(target);
+  int32_t *target2 = &target;
+  SHARED_RW_FROM_LOCAL(target2, target);
+
+  // let reference = unsafe { &*target2 };
+  READ1(target2);
+  int32_t *reference = target2;
+  SHARED_RO_FROM_REF(reference, target2);
+
+  // target = 13;
+  USE2_LOCAL(target);
+  target = 13;
+
+  // let _val = *reference;
+  READ1(reference); // fail
+  int32_t val = *reference;
+  return 0;
+}
@@ -0,0 +1,45 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a shared reference stored on the heap is invalidated by a write,
+/// miri tests/fail/stacked_borrows/load_invalid_shr.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 42;
+  int32_t local = 42;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int32_t *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  // let xraw = x as *mut i32;
+  USE2(x);
+  int32_t *xraw = x;
+  SHARED_RW_FROM_REF(xraw, x);
+
+  // let xref = unsafe { &*xraw };
+  READ1(xraw);
+  int32_t *xref = xraw;
+  SHARED_RO_FROM_REF(xref, xraw);
+
+  // let xref_in_mem = Box::new(xref);
+  int32_t **xref_in_mem = malloc(sizeof(int32_t *));
+  *xref_in_mem = xref;
+  TRANSMUTE_REF(*xref_in_mem, xref);
+
+  // unsafe { *xraw = 42 };
+  USE2(xraw);
+  *xraw = 42;
+
+  // let _val = *xref_in_mem;
+  READ1(*xref_in_mem); // fail
+  int32_t val = **xref_in_mem;
+  return 0;
+}
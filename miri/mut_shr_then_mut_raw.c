@@ -0,0 +1,40 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a raw pointer created after a shared reborrow can write,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs mut_shr_then_mut_raw
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 1;
+  int32_t x = 1;
+  NEW_LOCAL(x);
+
+  // let xref = &mut x;
+  USE2_LOCAL(x);
+  int32_t *xref = &x;
+  UNIQUE_FROM_LOCAL(xref, x);
+
+  // let _xshr = &*xref;
+  READ1(xref);
+  int32_t *xshr = xref;
+  SHARED_RO_FROM_REF(xshr, xref);
+
+  // let xraw = xref as *mut i32;
+  USE2(xref);
+  int32_t *xraw = xref;
+  SHARED_RW_FROM_REF(xraw, xref);
+
+  // unsafe { *xraw = 2; }
+  USE2(xraw);
+  *xraw = 2;
+
+  // assert_eq!(x, 2);
+  READ1_LOCAL(x);
+  assert(x == 2);
+  return 0;
+}
@@ -0,0 +1,30 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// writing a local invalidates the pointers cast from its shared references,
+/// miri tests/fail/stacked_borrows/outdated_local.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 0;
+  int32_t x = 0;
+  NEW_LOCAL(x);
+
+  // let y: *const i32 = &x;
+  READ1_LOCAL(x);
+  int32_t *y = &x;
+  SHARED_RO_FROM_LOCAL(y, x);
+
+  // x = 1;
+  USE2_LOCAL(x);
+  x = 1;
+
+  // assert_eq!(unsafe { *y }, 1);
+  READ1(y); // fail
+  int32_t val = *y;
+  return 0;
+}
@@ -0,0 +1,38 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a raw pointer kept in a global is invalidated by the reference it came from,
+/// miri tests/fail/stacked_borrows/pointer_smuggling.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // static mut PTR: *mut i32 = 0 as _;
+  static int32_t *PTR = NULL;
+
+  // let mut val = 0;
+  int32_t val = 0;
+  NEW_LOCAL(val);
+
+  // let val = &mut val;
+  USE2_LOCAL(val);
+  int32_t *val_ref = &val;
+  UNIQUE_FROM_LOCAL(val_ref, val);
+
+  // fun1(val): unsafe { PTR = x; }
+  USE2(val_ref);
+  PTR = val_ref;
+  SHARED_RW_FROM_REF(PTR, val_ref);
+
+  // *val = 2;
+  USE2(val_ref);
+  *val_ref = 2;
+
+  // fun2(): let _val = unsafe { *PTR };
+  READ1(PTR); // fail
+  int32_t v = *PTR;
+  return 0;
+}
@@ -0,0 +1,48 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// reading through a raw pointer keeps the shared references above it,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs read_does_not_invalidate2
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let r = foo(&mut local);
+  int32_t *r;
+  {
+    // fn foo(x: &mut i32) -> &i32
+    USE2_LOCAL(local);
+    int32_t *x = &local;
+    UNIQUE_FROM_LOCAL(x, local);
+
+    // let xraw = x as *mut i32;
+    USE2(x);
+    int32_t *xraw = x;
+    SHARED_RW_FROM_REF(xraw, x);
+
+    // let ret = unsafe { &*xraw };
+    READ1(xraw);
+    int32_t *ret = xraw;
+    SHARED_RO_FROM_REF(ret, xraw);
+
+    // let _val = unsafe { *xraw };
+    READ1(xraw);
+    int32_t val = *xraw;
+
+    // ret
+    r = ret;
+    TRANSMUTE_REF(r, ret);
+  }
+
+  // let _val = *r;
+  READ1(r);
+  int32_t val = *r;
+  return 0;
+}
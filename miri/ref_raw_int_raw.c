@@ -0,0 +1,31 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// reading through a raw pointer that went through an integer,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs ref_raw_int_raw
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 3;
+  int32_t x = 3;
+  NEW_LOCAL(x);
+
+  // let xref = &mut x;
+  USE2_LOCAL(x);
+  int32_t *xref = &x;
+  UNIQUE_FROM_LOCAL(xref, x);
+
+  // let xraw = xref as *mut i32 as usize as *mut i32;
+  USE2(xref);
+  int32_t *xraw = (int32_t *)(uintptr_t)xref;
+  SHARED_RW_FROM_REF(xraw, xref);
+
+  // assert_eq!(unsafe { *xraw }, 3);
+  READ1(xraw);
+  assert(*xraw == 3);
+  return 0;
+}
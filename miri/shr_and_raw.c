@@ -0,0 +1,38 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a raw pointer can write after a transmuted shared reborrow,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs shr_and_raw
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int32_t *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  // let y1: &i32 = unsafe { mem::transmute(&*x) };
+  READ1(x);
+  int32_t *shr = x;
+  SHARED_RO_FROM_REF(shr, x);
+  int32_t *y1 = shr;
+  TRANSMUTE_REF(y1, shr);
+
+  // let y2 = x as *const i32 as *mut i32;
+  USE2(x);
+  int32_t *y2 = x;
+  SHARED_RW_FROM_REF(y2, x);
+
+  // unsafe { *y2 += 1; }
+  USE2(y2);
+  *y2 += 1;
+  return 0;
+}
@@ -0,0 +1,40 @@
+// expected verdict: SUCCESSFUL
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// two raw pointers from the same reference can both write,
+/// miri tests/pass/stacked-borrows/stacked-borrows.rs two_raw
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut local = 0;
+  int32_t local = 0;
+  NEW_LOCAL(local);
+
+  // let x = &mut local;
+  USE2_LOCAL(local);
+  int32_t *x = &local;
+  UNIQUE_FROM_LOCAL(x, local);
+
+  // let y1 = x as *mut i32;
+  USE2(x);
+  int32_t *y1 = x;
+  SHARED_RW_FROM_REF(y1, x);
+
+  // let y2 = x as *mut i32;
+  USE2(x);
+  int32_t *y2 = x;
+  SHARED_RW_FROM_REF(y2, x);
+
+  // unsafe { *y1 += 2; }
+  USE2(y1);
+  *y1 += 2;
+
+  // unsafe { *y2 += 1; }
+  USE2(y2);
+  *y2 += 1;
+  return 0;
+}
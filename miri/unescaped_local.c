@@ -0,0 +1,31 @@
+// expected verdict: FAILED
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+/// a mutable borrow of a local invalidates its raw pointers,
+/// miri tests/fail/stacked_borrows/unescaped_local.rs
+int main() {
+  SB_INIT(true, 8);
+
+  // let mut x = 42;
+  int32_t x = 42;
+  NEW_LOCAL(x);
+
+  // let raw = &mut x as *mut i32 as usize as *mut i32;
+  USE2_LOCAL(x);
+  int32_t *raw = &x;
+  SHARED_RW_FROM_LOCAL(raw, x);
+
+  // let _ptr = &mut x;
+  USE2_LOCAL(x);
+  int32_t *ptr = &x;
+  UNIQUE_FROM_LOCAL(ptr, x);
+
+  // unsafe { *raw = 13; }
+  USE2(raw); // fail
+  *raw = 13;
+  return 0;
+}
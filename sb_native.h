@@ -0,0 +1,117 @@
+#ifndef SB_NATIVE_DEFINED
+#define SB_NATIVE_DEFINED
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+  Native replacements for the CBMC built-ins used by the model, so that
+  instrumented programs compiled with -DSB_NATIVE by gcc or clang run
+  concretely, Miri-style, instead of being analysed by symex.
+  - a failing __CPROVER_assert reports the violated rule and exits with
+    status 10, the status CBMC uses for a failed verification,
+  - __CPROVER_assume(false) silently ends the execution,
+  - nondet_* functions draw values from rand(), seeded from the SB_SEED
+    environment variable so that different executions can be explored,
+  - malloc, calloc and realloc record the size of each heap object, which
+    NEW_DYNAMIC reads back where CBMC uses __CPROVER_OBJECT_SIZE.
+*/
+
+// exit status of an execution that violates a stacked borrows rule
+#define SB_NATIVE_FAILURE 10
+
+void sb_native_assert(bool cond, const char *msg, const char *file, int line) {
+  if (cond)
+    return;
+  fprintf(stderr, "%s:%d: stacked borrows violation: %s\n", file, line, msg);
+  exit(SB_NATIVE_FAILURE);
+}
+
+#define __CPROVER_assert(cond, msg)                                            \
+  sb_native_assert((cond), (msg), __FILE__, __LINE__)
+
+void sb_native_assume(bool cond) {
+  if (!cond)
+    exit(EXIT_SUCCESS);
+}
+
+#define __CPROVER_assume(cond) sb_native_assume(cond)
+
+// Allocates zero-initialised memory, aborts when out of memory.
+void *sb_native_allocate(size_t size) {
+  void *ptr = calloc(1, size ? size : 1);
+  if (!ptr) {
+    perror("stacked borrows: shadow allocation failed");
+    abort();
+  }
+  return ptr;
+}
+
+#define __CPROVER_allocate(size, zero) sb_native_allocate(size)
+
+// Returns the next pseudo random value, seeding the generator with SB_SEED
+// on first use.
+int sb_native_rand() {
+  static bool seeded = false;
+  if (!seeded) {
+    const char *seed = getenv("SB_SEED");
+    srand(seed ? (unsigned)strtoul(seed, NULL, 0) : 1u);
+    seeded = true;
+  }
+  return rand();
+}
+
+bool nondet_bool() { return sb_native_rand() & 1; }
+
+size_t nondet_size_t() { return (size_t)sb_native_rand(); }
+
+// Heap objects of the program carry their size in a header in front of them,
+// see the allocation macros at the end of stacked_borrows.h.
+typedef union {
+  size_t size;
+  max_align_t align;
+} sb_native_block_t;
+
+// Allocates a heap object of size bytes, NULL when out of memory.
+void *sb_native_malloc(size_t size) {
+  sb_native_block_t *block = malloc(sizeof(sb_native_block_t) + size);
+  if (!block)
+    return NULL;
+  block->size = size;
+  return block + 1;
+}
+
+void *sb_native_calloc(size_t n, size_t size) {
+  if (size && n > (SIZE_MAX - sizeof(sb_native_block_t)) / size)
+    return NULL;
+  sb_native_block_t *block = calloc(1, sizeof(sb_native_block_t) + n * size);
+  if (!block)
+    return NULL;
+  block->size = n * size;
+  return block + 1;
+}
+
+void *sb_native_realloc(void *ptr, size_t size) {
+  sb_native_block_t *block =
+      realloc(ptr ? (sb_native_block_t *)ptr - 1 : NULL,
+              sizeof(sb_native_block_t) + size);
+  if (!block)
+    return NULL;
+  block->size = size;
+  return block + 1;
+}
+
+void sb_native_free(void *ptr) {
+  if (ptr)
+    free((sb_native_block_t *)ptr - 1);
+}
+
+// Returns the size of the heap object ptr points to, which must have been
+// returned by one of the allocation functions above, 0 for NULL.
+size_t sb_native_dynamic_size(void *ptr) {
+  return ptr ? ((sb_native_block_t *)ptr - 1)->size : 0;
+}
+
+#endif
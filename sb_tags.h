@@ -0,0 +1,72 @@
+#ifndef SB_TAGS_DEFINED
+#define SB_TAGS_DEFINED
+#include <stdint.h>
+
+/*
+  Borrow IDs, or tags, of both stacked_borrows.h and
+  stacked_borrows_demonic.h: their width, the reserved tags and the stream of
+  fresh tags, which fails verification once it runs out of tags instead of
+  wrapping around.
+*/
+
+// Borrow ID type, SB_TAG_BITS wide (8, 16, 32 or 64)
+// We track at most 2^(SB_TAG_BITS - 1) - 1 borrows in the program
+#ifndef SB_TAG_BITS
+#define SB_TAG_BITS 8
+#endif
+#if SB_TAG_BITS == 8
+typedef int8_t sb_id_t;
+typedef uint8_t sb_uid_t;
+#define SB_ID_MAX INT8_MAX
+#elif SB_TAG_BITS == 16
+typedef int16_t sb_id_t;
+typedef uint16_t sb_uid_t;
+#define SB_ID_MAX INT16_MAX
+#elif SB_TAG_BITS == 32
+typedef int32_t sb_id_t;
+typedef uint32_t sb_uid_t;
+#define SB_ID_MAX INT32_MAX
+#elif SB_TAG_BITS == 64
+typedef int64_t sb_id_t;
+typedef uint64_t sb_uid_t;
+#ifdef SB_PACKED_ITEMS
+// packed items keep the 3 high bits of the word for the kind
+#define SB_ID_MAX (((int64_t)1 << 60) - 1)
+#else
+#define SB_ID_MAX INT64_MAX
+#endif
+#else
+#error "SB_TAG_BITS must be 8, 16, 32 or 64"
+#endif
+
+// Borrow ID used for raw pointers
+const sb_id_t __sb_id_bottom = -1;
+
+// Borrow ID of memory locations that hold no tag, e.g. dead pointer variables
+const sb_id_t __sb_id_null = 0;
+
+// Generates a stream of unique borrow IDs
+sb_id_t __sb_id_fresh = 1;
+
+#if defined(SB_TAG_GC) && defined(SB_NATIVE)
+// number of fresh borrow IDs between two automatic collections
+#ifndef SB_GC_PERIOD
+#define SB_GC_PERIOD 64
+#endif
+void sb_gc();
+#endif
+
+// Returns a fresh borrow ID
+sb_id_t sb_id_fresh() {
+  __CPROVER_assert(__sb_id_fresh < SB_ID_MAX,
+                   "no more than SB_ID_MAX - 1 borrow IDs");
+#if defined(SB_TAG_GC) && defined(SB_NATIVE)
+  if (__sb_id_fresh % SB_GC_PERIOD == 0)
+    sb_gc();
+#endif
+  sb_id_t res = __sb_id_fresh;
+  __sb_id_fresh++;
+  return res;
+}
+
+#endif
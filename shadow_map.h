@@ -18,7 +18,7 @@
 
 typedef struct {
   // nof shadow bytes per byte
-  size_t shift;
+  size_t k;
   // pointers to shadow objects
   void **ptrs;
 } shadow_map_t;
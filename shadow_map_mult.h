@@ -1,6 +1,7 @@
 #ifndef CPROVER_SHADOW_MAP_DEFINED
 #define CPROVER_SHADOW_MAP_DEFINED
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /*
@@ -14,13 +15,27 @@
   by k.
   It is possible to allocate several different shadow maps with different k
   values in a same program.
+  The map from object IDs to shadow objects is a two-level page table: the high
+  bits of the object ID index a directory of lazily allocated leaves, the low
+  SHADOW_LEAF_BITS bits index the leaf that holds the shadow object pointers.
+  Only the directory is allocated upfront, so memory grows with the number of
+  objects actually touched rather than with 2^OBJECT_BITS.
+  A map can also be initialised with shadow_map_init_chunks to map each
+  aligned chunk of 2^chunk_bits bytes, rather than each byte, to k shadow
+  bytes, dividing the size of the shadow objects by the chunk size.
 */
 
+// nof object IDs covered by a leaf of the directory
+#define SHADOW_LEAF_BITS 4
+#define SHADOW_LEAF_SIZE ((size_t)1 << SHADOW_LEAF_BITS)
+
 typedef struct {
-  // nof shadow bytes per byte
+  // nof shadow bytes per byte, or per chunk
   size_t shadow_bytes_per_byte;
-  // pointers to shadow objects
-  void **ptrs;
+  // log2 of the nof bytes per chunk
+  size_t chunk_bits;
+  // directory of leaves of pointers to shadow objects
+  void ***dir;
 } shadow_map_t;
 
 extern size_t __CPROVER_max_malloc_size;
@@ -30,33 +45,83 @@ int __builtin_clzll(unsigned long long);
 #define __nof_objects                                                          \
   ((size_t)(1ULL << __builtin_clzll(__CPROVER_max_malloc_size)))
 
-// Initialises the given shadow memory map
-void shadow_map_init(shadow_map_t *smap, size_t shadow_bytes_per_byte) {
+// nof directory entries needed to cover all object IDs
+#define __nof_leaves                                                           \
+  ((__nof_objects + SHADOW_LEAF_SIZE - 1) >> SHADOW_LEAF_BITS)
+
+// Initialises the given shadow memory map with shadow_bytes_per_byte shadow
+// bytes per chunk of 2^chunk_bits bytes
+void shadow_map_init_chunks(shadow_map_t *smap, size_t shadow_bytes_per_byte,
+                            size_t chunk_bits) {
   __CPROVER_assert(1 == shadow_bytes_per_byte || 2 == shadow_bytes_per_byte ||
-                       4 == shadow_bytes_per_byte || 8 == shadow_bytes_per_byte,
-                   "shadow_bytes_per_byte must be in {1, 2, 4, 8}");
+                       4 == shadow_bytes_per_byte ||
+                       8 == shadow_bytes_per_byte ||
+                       16 == shadow_bytes_per_byte,
+                   "shadow_bytes_per_byte must be in {1, 2, 4, 8, 16}");
+  __CPROVER_assert(chunk_bits <= 4, "chunks of at most 16 bytes");
   *smap = (shadow_map_t){
       .shadow_bytes_per_byte = shadow_bytes_per_byte,
-      .ptrs = __CPROVER_allocate(__nof_objects * sizeof(void *), 1)};
+      .chunk_bits = chunk_bits,
+      .dir = __CPROVER_allocate(__nof_leaves * sizeof(void **), 1)};
+}
+
+// Initialises the given shadow memory map with shadow_bytes_per_byte shadow
+// bytes per byte
+void shadow_map_init(shadow_map_t *smap, size_t shadow_bytes_per_byte) {
+  shadow_map_init_chunks(smap, shadow_bytes_per_byte, 0);
 }
 
-// Returns a pointer to the shadow bytes of the byte pointed to by ptr
+// Returns the slot of the leaf that holds the shadow object pointer of the
+// object with the given ID, allocating the leaf if needed
+void **shadow_map_leaf_slot(shadow_map_t *smap, size_t id) {
+  void **leaf = smap->dir[id >> SHADOW_LEAF_BITS];
+  if (!leaf) {
+    leaf = __CPROVER_allocate(SHADOW_LEAF_SIZE * sizeof(void *), 1);
+    smap->dir[id >> SHADOW_LEAF_BITS] = leaf;
+  }
+  return &leaf[id & (SHADOW_LEAF_SIZE - 1)];
+}
+
+// Returns a pointer to the shadow bytes of the chunk of the byte pointed to by
+// ptr
 void *shadow_map_get(shadow_map_t *smap, void *ptr) {
-  __CPROVER_size_t id = __CPROVER_POINTER_OBJECT(ptr);
-  __CPROVER_size_t size = __CPROVER_OBJECT_SIZE(ptr);
-  __CPROVER_size_t offset = __CPROVER_POINTER_OFFSET(ptr);
+  size_t size = __CPROVER_OBJECT_SIZE(ptr);
+  size_t offset = __CPROVER_POINTER_OFFSET(ptr);
+  size_t chunk_mask = ((size_t)1 << smap->chunk_bits) - 1;
+  // nof chunks of the object and index of the chunk of ptr
+  size_t nof_chunks = (size >> smap->chunk_bits) + ((size & chunk_mask) != 0);
+  size_t chunk = offset >> smap->chunk_bits;
 
-  size_t max_size = SIZE_MAX / smap->shadow_bytes_per_byte;
-  __CPROVER_assert(size <= max_size, " no overflow on size scaling");
-  __CPROVER_assert(offset <= max_size, " no overflow on offset scaling");
+  size_t max_chunks = SIZE_MAX / smap->shadow_bytes_per_byte;
+  __CPROVER_assert(nof_chunks <= max_chunks, " no overflow on size scaling");
+  __CPROVER_assert(chunk <= max_chunks, " no overflow on offset scaling");
 
-  void *sptr = smap->ptrs[id];
+  void **slot = shadow_map_leaf_slot(smap, __CPROVER_POINTER_OBJECT(ptr));
+  void *sptr = *slot;
   if (!sptr) {
-    sptr = __CPROVER_allocate(
-        smap->shadow_bytes_per_byte * __CPROVER_OBJECT_SIZE(ptr), 1);
-    smap->ptrs[id] = sptr;
+    sptr = __CPROVER_allocate(smap->shadow_bytes_per_byte * nof_chunks, 1);
+    *slot = sptr;
   }
-  return sptr + (smap->shadow_bytes_per_byte * __CPROVER_POINTER_OFFSET(ptr));
+  return sptr + (smap->shadow_bytes_per_byte * chunk);
+}
+
+/*
+  A shadow map can instead be used as an object map that associates a single
+  pointer with each object, by using the slot that would hold the shadow
+  object. A map must not be used both ways.
+*/
+
+// Declares the size bytes pointed to by ptr as a new object, nothing to do
+// since CBMC knows the objects of the program.
+void shadow_map_new_object(shadow_map_t *smap, void *ptr, size_t size) {}
+
+// Returns the slot holding the pointer associated with the object pointed to
+// by ptr, and stores the offset of ptr in that object and the object size.
+void **shadow_map_get_object(shadow_map_t *smap, void *ptr, size_t *offset,
+                             size_t *size) {
+  *offset = __CPROVER_POINTER_OFFSET(ptr);
+  *size = __CPROVER_OBJECT_SIZE(ptr);
+  return shadow_map_leaf_slot(smap, __CPROVER_POINTER_OBJECT(ptr));
 }
 
 #endif
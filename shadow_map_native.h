@@ -0,0 +1,172 @@
+#ifndef NATIVE_SHADOW_MAP_DEFINED
+#define NATIVE_SHADOW_MAP_DEFINED
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Native counterpart of shadow_map_mult.h used when compiling with
+  -DSB_NATIVE.
+  Outside of CBMC pointers carry no object ID, so shadow memory is indexed by
+  address instead. The address space is cut into pages of 2^SHADOW_PAGE_BITS
+  bytes and each page that gets touched is lazily mapped to a zero-initialised
+  shadow page holding k shadow bytes per byte, or per aligned chunk of
+  2^chunk_bits bytes with shadow_map_init_chunks.
+  Shadow pages are found through a two-level page table covering the
+  2^SHADOW_ADDRESS_BITS bytes of user space addresses: the high bits of the
+  address index a lazily allocated directory of leaves, the middle
+  SHADOW_LEAF_BITS bits index a lazily allocated leaf of shadow page pointers.
+  Used as an object map, the map keeps a sorted array of the objects declared
+  with shadow_map_new_object, found by binary search.
+*/
+
+#define SHADOW_ADDRESS_BITS 48
+#define SHADOW_PAGE_BITS 12
+#define SHADOW_LEAF_BITS 18
+#define SHADOW_DIR_BITS                                                        \
+  (SHADOW_ADDRESS_BITS - SHADOW_LEAF_BITS - SHADOW_PAGE_BITS)
+
+#define SHADOW_PAGE_SIZE ((size_t)1 << SHADOW_PAGE_BITS)
+#define SHADOW_LEAF_SIZE ((size_t)1 << SHADOW_LEAF_BITS)
+#define SHADOW_DIR_SIZE ((size_t)1 << SHADOW_DIR_BITS)
+
+// An object declared in an object map
+typedef struct {
+  // address of the first byte
+  uintptr_t base;
+  // number of bytes
+  size_t size;
+  // pointer associated with the object
+  void *value;
+} shadow_object_t;
+
+typedef struct {
+  // nof shadow bytes per chunk
+  size_t k;
+  // log2 of the nof bytes per chunk
+  size_t chunk_bits;
+  // directory of leaves of pointers to shadow pages
+  uint8_t ***dir;
+  // non overlapping objects sorted by address
+  shadow_object_t *objects;
+  // number of objects
+  size_t nof_objects;
+  // number of objects that fit in objects
+  size_t objects_capacity;
+} shadow_map_t;
+
+// Initialises the given shadow memory map with k shadow bytes per chunk of
+// 2^chunk_bits bytes, releasing any previous content
+void shadow_map_init_chunks(shadow_map_t *smap, size_t k, size_t chunk_bits) {
+  assert(1 == k || 2 == k || 4 == k || k == 8 || k == 16);
+  assert(chunk_bits <= 4);
+  if (smap->dir) {
+    for (size_t i = 0; i < SHADOW_DIR_SIZE; i++) {
+      if (!smap->dir[i])
+        continue;
+      for (size_t j = 0; j < SHADOW_LEAF_SIZE; j++)
+        free(smap->dir[i][j]);
+      free(smap->dir[i]);
+    }
+    free(smap->dir);
+  }
+  free(smap->objects);
+  *smap = (shadow_map_t){
+      .k = k, .chunk_bits = chunk_bits, .dir = NULL, .objects = NULL};
+}
+
+// Initialises the given shadow memory map with k shadow bytes per byte
+void shadow_map_init(shadow_map_t *smap, size_t k) {
+  shadow_map_init_chunks(smap, k, 0);
+}
+
+// Returns a zero-initialised array of n pointers, aborts when out of memory
+void *shadow_map_alloc_table(size_t n) {
+  void *table = calloc(n, sizeof(void *));
+  assert(table);
+  return table;
+}
+
+// Returns a pointer to the shadow bytes of the chunk of the byte pointed to by
+// ptr
+void *shadow_map_get(shadow_map_t *smap, void *ptr) {
+  uintptr_t addr = (uintptr_t)ptr;
+  assert(addr >> SHADOW_ADDRESS_BITS == 0);
+  size_t dir_index = addr >> (SHADOW_PAGE_BITS + SHADOW_LEAF_BITS);
+  size_t leaf_index = (addr >> SHADOW_PAGE_BITS) & (SHADOW_LEAF_SIZE - 1);
+  if (!smap->dir)
+    smap->dir = shadow_map_alloc_table(SHADOW_DIR_SIZE);
+  uint8_t **leaf = smap->dir[dir_index];
+  if (!leaf) {
+    leaf = shadow_map_alloc_table(SHADOW_LEAF_SIZE);
+    smap->dir[dir_index] = leaf;
+  }
+  uint8_t *spage = leaf[leaf_index];
+  if (!spage) {
+    spage = calloc(SHADOW_PAGE_SIZE >> smap->chunk_bits, smap->k);
+    assert(spage);
+    leaf[leaf_index] = spage;
+  }
+  return spage +
+         smap->k * ((addr & (SHADOW_PAGE_SIZE - 1)) >> smap->chunk_bits);
+}
+
+// Returns the index of the first object that ends after addr
+size_t shadow_map_object_index(shadow_map_t *smap, uintptr_t addr) {
+  size_t lo = 0, hi = smap->nof_objects;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (smap->objects[mid].base + smap->objects[mid].size <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Declares the size bytes pointed to by ptr as a new object, forgetting the
+// objects it overlaps: their memory has been reused.
+void shadow_map_new_object(shadow_map_t *smap, void *ptr, size_t size) {
+  uintptr_t base = (uintptr_t)ptr;
+  size_t lo = shadow_map_object_index(smap, base);
+  size_t hi = lo;
+  while (hi < smap->nof_objects && smap->objects[hi].base < base + size)
+    hi++;
+  if (lo == hi) {
+    // no overlap, make room for the new object
+    if (smap->nof_objects == smap->objects_capacity) {
+      smap->objects_capacity =
+          smap->objects_capacity ? 2 * smap->objects_capacity : 64;
+      smap->objects = realloc(smap->objects, smap->objects_capacity *
+                                                 sizeof(shadow_object_t));
+      assert(smap->objects);
+    }
+    memmove(&smap->objects[lo + 1], &smap->objects[lo],
+            (smap->nof_objects - lo) * sizeof(shadow_object_t));
+    smap->nof_objects++;
+  } else {
+    // the new object replaces the objects in [lo, hi)
+    memmove(&smap->objects[lo + 1], &smap->objects[hi],
+            (smap->nof_objects - hi) * sizeof(shadow_object_t));
+    smap->nof_objects -= hi - lo - 1;
+  }
+  smap->objects[lo] =
+      (shadow_object_t){.base = base, .size = size, .value = NULL};
+}
+
+// Returns the slot holding the pointer associated with the object pointed to
+// by ptr, and stores the offset of ptr in that object and the object size.
+// Returns NULL if ptr does not point into a declared object.
+void **shadow_map_get_object(shadow_map_t *smap, void *ptr, size_t *offset,
+                             size_t *size) {
+  uintptr_t addr = (uintptr_t)ptr;
+  size_t i = shadow_map_object_index(smap, addr);
+  if (i == smap->nof_objects || smap->objects[i].base > addr)
+    return NULL;
+  *offset = addr - smap->objects[i].base;
+  *size = smap->objects[i].size;
+  return &smap->objects[i].value;
+}
+
+#endif
@@ -13,7 +13,13 @@
 
 // analyse with --slice-formula and minisat
 // remoarks
+// compile with -DSB_NATIVE to execute natively instead of analysing with CBMC
+#ifdef SB_NATIVE
+#include "sb_native.h"
+#include "shadow_map_native.h"
+#else
 #include "shadow_map_mult.h"
+#endif
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -22,9 +28,38 @@
 // use symbolic sizes for maps and stacks
 bool SB_SYMSIZE = true;
 
+// -DSB_FORCE_SYMSIZE=0 or 1 overrides the symbolic_size argument of SB_INIT
+#ifdef SB_FORCE_SYMSIZE
+#define SB_SYMSIZE_ARG(symbolic_size) SB_FORCE_SYMSIZE
+#else
+#define SB_SYMSIZE_ARG(symbolic_size) (symbolic_size)
+#endif
+
 // maximum stack size
 size_t SB_MAX_STACK_SIZE = 32;
 
+// Compiling with -DSB_CONTRACTS attaches function and loop contracts to the
+// stack rules, so that goto-instrument can check them once with
+// --enforce-contract and replace the calls with them with
+// --replace-call-with-contract, see make contracts and make <harness>_contracts.
+#ifdef SB_CONTRACTS
+#if defined(SB_NATIVE) || defined(SB_STACK_CACHE) || defined(SB_RO_SETS) ||   \
+    defined(SB_PACKED_ITEMS) || defined(SB_RANGE_STACKS) || defined(SB_TAG_GC)
+#error "SB_CONTRACTS only covers the plain stack layout under CBMC"
+#endif
+#define SB_REQUIRES(cond) __CPROVER_requires(cond)
+#define SB_ENSURES(cond) __CPROVER_ensures(cond)
+#define SB_ASSIGNS(...) __CPROVER_assigns(__VA_ARGS__)
+#define SB_LOOP_INVARIANT(cond) __CPROVER_loop_invariant(cond)
+#define SB_DECREASES(expr) __CPROVER_decreases(expr)
+#else
+#define SB_REQUIRES(cond)
+#define SB_ENSURES(cond)
+#define SB_ASSIGNS(...)
+#define SB_LOOP_INVARIANT(cond)
+#define SB_DECREASES(expr)
+#endif
+
 // Borrow kind
 typedef uint8_t sb_kind_t;
 // &mut x
@@ -36,44 +71,201 @@ const sb_kind_t SB_SHARED_RW = 0x4;
 // disabled &mut x
 const sb_kind_t SB_DISABLED = 0x4;
 
-// Borrow ID type
-// We track at most 128 borrows in the program
-typedef int8_t sb_id_t;
+// Borrow IDs, shared with stacked_borrows_demonic.h
+#include "sb_tags.h"
+
+#ifdef SB_RO_SETS
+#ifdef SB_STACK_CACHE
+#error "SB_RO_SETS is incompatible with SB_STACK_CACHE"
+#endif
+// Set of SB_SHARED_RO tags, bit i stands for tag base + i
+typedef uint32_t sb_ro_mask_t;
+#define SB_RO_SET_BITS 32
+#endif
+
+#if defined(SB_QUANTIFIERS) && (defined(SB_STACK_CACHE) || defined(SB_RO_SETS))
+#error "SB_QUANTIFIERS is incompatible with SB_STACK_CACHE and SB_RO_SETS"
+#endif
+
+#ifdef SB_POSITION_INDEX
+#if defined(SB_STACK_CACHE) || defined(SB_RO_SETS) ||                         \
+    defined(SB_QUANTIFIERS) || defined(SB_CONTRACTS)
+#error "SB_POSITION_INDEX is incompatible with SB_STACK_CACHE, SB_RO_SETS, \
+SB_QUANTIFIERS and SB_CONTRACTS"
+#endif
+// number of tags the position index can hold, __sb_id_bottom included
+#ifndef SB_POSITION_TAGS
+#define SB_POSITION_TAGS 128
+#endif
+#endif
+
+// Compiling with -DSB_GRANULE=<n> tracks a borrow stack per aligned chunk of
+// n bytes instead of per byte, n in {1, 2, 4, 8, 16}. Borrows and accesses
+// must start at the first byte of a chunk, e.g. -DSB_GRANULE=4 for harnesses
+// borrowing int32_t fields.
+#ifndef SB_GRANULE
+#define SB_GRANULE 1
+#endif
+#if SB_GRANULE == 1
+#define SB_GRANULE_BITS 0
+#elif SB_GRANULE == 2
+#define SB_GRANULE_BITS 1
+#elif SB_GRANULE == 4
+#define SB_GRANULE_BITS 2
+#elif SB_GRANULE == 8
+#define SB_GRANULE_BITS 3
+#elif SB_GRANULE == 16
+#define SB_GRANULE_BITS 4
+#else
+#error "SB_GRANULE must be 1, 2, 4, 8 or 16"
+#endif
+#if SB_GRANULE > 1 && (defined(SB_RANGE_STACKS) ||                            \
+                       defined(SB_CPROVER_SHADOW) || defined(SB_FUSED_SHADOW))
+#error "SB_GRANULE is incompatible with SB_RANGE_STACKS, SB_CPROVER_SHADOW \
+and SB_FUSED_SHADOW"
+#endif
 
-// Borrow ID used for raw pointers
-const sb_id_t __sb_id_bottom = -1;
+#ifdef SB_PACKED_ITEMS
+#ifdef SB_RO_SETS
+#error "SB_PACKED_ITEMS is incompatible with SB_RO_SETS"
+#endif
+// Representation of a borrow stack item packed in a single word, the kind in
+// the high bits and the borrow ID in the low bits, so that checking an item
+// against a kind and an ID is a single comparison.
+#if SB_TAG_BITS == 8
+typedef uint16_t sb_item_t;
+#elif SB_TAG_BITS == 16
+typedef uint32_t sb_item_t;
+#else
+typedef uint64_t sb_item_t;
+#endif
+
+// number of low bits holding the borrow ID
+#if SB_TAG_BITS == 64
+#define SB_ITEM_ID_BITS 61
+#else
+#define SB_ITEM_ID_BITS SB_TAG_BITS
+#endif
 
-// Generates a stream of unique borrow IDs
-sb_id_t __sb_id_fresh = 0;
+#define SB_ITEM_ID_MASK (((sb_item_t)1 << SB_ITEM_ID_BITS) - 1)
 
-// Returns a fresh borrow ID
-sb_id_t sb_id_fresh() {
-  assert(__sb_id_fresh < UINT16_MAX);
-  sb_id_t res = __sb_id_fresh;
-  __sb_id_fresh++;
-  return res;
+sb_item_t sb_item(sb_kind_t kind, sb_id_t id) {
+  return (sb_item_t)kind << SB_ITEM_ID_BITS | ((sb_uid_t)id & SB_ITEM_ID_MASK);
 }
 
+sb_kind_t sb_item_kind(sb_item_t item) { return item >> SB_ITEM_ID_BITS; }
+
+sb_id_t sb_item_id(sb_item_t item) {
+#if SB_TAG_BITS == 64
+  // sign extend the 61 bit ID
+  return (int64_t)(item << 3) >> 3;
+#else
+  return (sb_id_t)(sb_uid_t)item;
+#endif
+}
+
+bool sb_item_is(sb_item_t item, sb_kind_t kind, sb_id_t id) {
+  return item == sb_item(kind, id);
+}
+#else
 // Representation of a borrow stack item
 typedef struct {
   sb_kind_t kind;
   sb_id_t id;
+#ifdef SB_RO_SETS
+  // the SB_SHARED_RO items directly above this item, stored as a set
+  sb_id_t ro_base;
+  sb_ro_mask_t ro_mask;
+#endif
 } sb_item_t;
 
+sb_item_t sb_item(sb_kind_t kind, sb_id_t id) {
+  return (sb_item_t){.kind = kind, .id = id};
+}
+
+sb_kind_t sb_item_kind(sb_item_t item) { return item.kind; }
+
+sb_id_t sb_item_id(sb_item_t item) { return item.id; }
+
+bool sb_item_is(sb_item_t item, sb_kind_t kind, sb_id_t id) {
+  return item.kind == kind && item.id == id;
+}
+#endif
+
+#ifdef SB_STACK_CACHE
+// number of recently found items cached per stack
+#ifndef SB_CACHE_SIZE
+#define SB_CACHE_SIZE 4
+#endif
+#endif
+
 // A stack of borrow items
-typedef struct {
+typedef struct sb_stack_s {
   // Index of the next free slot in elems
   int8_t top;
   // An array of borrow items
   sb_item_t *elems;
+#ifdef SB_STACK_CACHE
+  // number of valid cache entries
+  int8_t cache_size;
+  // tags of the recently found items, most recent first
+  sb_id_t cache_ids[SB_CACHE_SIZE];
+  // index of the lowest item with the cached tag
+  int8_t cache_indices[SB_CACHE_SIZE];
+#endif
+#ifdef SB_POSITION_INDEX
+  // 1 + the index of the lowest item of each tag, 0 if none, valid only if
+  // that item is still in the stack. __sb_id_bottom uses entry 0.
+  int8_t *positions;
+  // index of the highest item that is not SB_SHARED_RO at or below each
+  // index, -1 if none
+  int8_t *non_ro;
+#endif
+#ifdef SB_TAG_GC
+  // next stack in __sb_stacks
+  struct sb_stack_s *next;
+#endif
 } sb_stack_t;
 
+#ifdef SB_TAG_GC
+// The garbage collector needs to enumerate all stacks and all memory
+// locations that hold a tag in the id map.
+
+// all borrow stacks created so far
+sb_stack_t *__sb_stacks = NULL;
+
+// A memory location that holds a tag in the id map
+typedef struct sb_slot_s {
+  void *addr;
+  struct sb_slot_s *next;
+} sb_slot_t;
+
+// all memory locations that received a tag since they last held none
+sb_slot_t *__sb_slots = NULL;
+
+// Registers addr as holding a tag when it is about to receive one while
+// holding none
+void sb_gc_track(void *addr, sb_id_t old_id) {
+  if (old_id != __sb_id_null)
+    return;
+  sb_slot_t *slot = __CPROVER_allocate(sizeof(*slot), 1);
+  *slot = (sb_slot_t){.addr = addr, .next = __sb_slots};
+  __sb_slots = slot;
+}
+#else
+#define sb_gc_track(addr, old_id)
+#endif
+
 size_t nondet_size_t();
 
 // returns size if symbolic is false, a nondet constrained to
 // be at least size otherwise
 size_t __init_size(bool symbolic, size_t size) {
-  assert(size <= UINT8_MAX);
+  assert(size <= UINT16_MAX);
+#ifdef SB_NATIVE
+  // sizes are always concrete when executing natively
+  symbolic = false;
+#endif
   if (!symbolic)
     return size;
   size_t result = nondet_size_t();
@@ -90,23 +282,337 @@ sb_stack_t *sb_stack_create() {
       .top = 0,
       .elems = __CPROVER_allocate(
           __init_size(SB_SYMSIZE, sizeof(sb_item_t) * SB_MAX_STACK_SIZE), 1)};
+#ifdef SB_POSITION_INDEX
+  stack->positions = __CPROVER_allocate(
+      __init_size(SB_SYMSIZE, sizeof(int8_t) * SB_POSITION_TAGS), 1);
+  stack->non_ro = __CPROVER_allocate(
+      __init_size(SB_SYMSIZE, sizeof(int8_t) * SB_MAX_STACK_SIZE), 1);
+#endif
+#ifdef SB_TAG_GC
+  stack->next = __sb_stacks;
+  __sb_stacks = stack;
+#endif
   return stack;
 }
 
-void sb_stack_push(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+#ifdef SB_RO_SETS
+// Runs of SB_SHARED_RO items are compressed: each item holds the set of
+// SB_SHARED_RO tags pushed directly above it, as a SB_RO_SET_BITS wide window
+// of the tag space starting at the first tag of the run. Fresh tags increase,
+// so a run created by many shared reborrows usually fits in one window, the
+// tags that do not are pushed as regular items.
+
+// Returns true if the set of the item contains id
+bool sb_ro_set_contains(sb_item_t *item, sb_id_t id) {
+  return item->ro_mask != 0 && id >= item->ro_base &&
+         id - item->ro_base < SB_RO_SET_BITS &&
+         ((item->ro_mask >> (id - item->ro_base)) & 1);
+}
+
+// Adds id to the set of the item, returns false if it is outside the window
+bool sb_ro_set_add(sb_item_t *item, sb_id_t id) {
+  if (item->ro_mask == 0)
+    item->ro_base = id;
+  else if (id < item->ro_base || id - item->ro_base >= SB_RO_SET_BITS)
+    return false;
+  item->ro_mask |= (sb_ro_mask_t)1 << (id - item->ro_base);
+  return true;
+}
+#endif
+
+#ifdef SB_CONTRACTS
+// The stack and its items are valid and separate from any other object
+#define SB_STACK_VALID(stack)                                                  \
+  (__CPROVER_is_fresh(stack, sizeof(*stack)) &&                               \
+   SB_MAX_STACK_SIZE <= INT8_MAX && 0 <= (stack)->top &&                      \
+   (stack)->top <= SB_MAX_STACK_SIZE &&                                       \
+   __CPROVER_is_fresh((stack)->elems, SB_MAX_STACK_SIZE * sizeof(sb_item_t)))
+
+// Item i of the stack is (kind, id)
+#define SB_ITEM_AT_IS(stack, i, kind_, id_)                                    \
+  ((stack)->elems[i].kind == (kind_) && (stack)->elems[i].id == (id_))
+#endif
+
+#ifdef SB_POSITION_INDEX
+// Stacks only grow by pushing and shrink by lowering top, so an item is in the
+// stack exactly when its index is below top and the slot still holds it. The
+// position index records the index of each tag, the rules look tags up
+// instead of scanning the stack.
+
+// Entry of a tag in the position index
+size_t sb_position_slot(sb_id_t id) {
+  return id == __sb_id_bottom ? 0 : (size_t)id;
+}
+
+// Returns the index of the lowest item tagged with id, -1 if there is none
+int8_t sb_stack_position(sb_stack_t *stack, sb_id_t id) {
+  size_t slot = sb_position_slot(id);
+  if (slot >= SB_POSITION_TAGS)
+    return -1;
+  int8_t i = stack->positions[slot] - 1;
+  if (i < 0 || i >= stack->top || sb_item_id(stack->elems[i]) != id)
+    return -1;
+  return i;
+}
+
+// Records the item (kind, id) about to be pushed at index top
+void sb_stack_index(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+  int8_t top = stack->top;
+  size_t slot = sb_position_slot(id);
+  __CPROVER_assert(slot < SB_POSITION_TAGS,
+                   "no more than SB_POSITION_TAGS tags in the position index");
+  // __sb_id_bottom keeps the index of its lowest item
+  if (id != __sb_id_bottom || sb_stack_position(stack, id) < 0)
+    stack->positions[slot] = top + 1;
+  if (kind != SB_SHARED_RO)
+    stack->non_ro[top] = top;
+  else
+    stack->non_ro[top] = top > 0 ? stack->non_ro[top - 1] : -1;
+}
+
+// Rebuilds the position index after items moved
+void sb_stack_reindex(sb_stack_t *stack) {
+  int8_t top = stack->top;
+  stack->top = 0;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < top); i++) {
+    sb_stack_index(stack, sb_item_kind(stack->elems[i]),
+                   sb_item_id(stack->elems[i]));
+    stack->top++;
+  }
+}
+#endif
+
+void sb_stack_push(sb_stack_t *stack, sb_kind_t kind, sb_id_t id)
+    SB_REQUIRES(SB_STACK_VALID(stack) && stack->top < SB_MAX_STACK_SIZE)
+    SB_ASSIGNS(stack->top, stack->elems[stack->top])
+    SB_ENSURES(stack->top == __CPROVER_old(stack->top) + 1 &&
+               SB_ITEM_AT_IS(stack, stack->top - 1, kind, id))
+{
+#ifdef SB_RO_SETS
+  if (kind == SB_SHARED_RO && stack->top > 0 &&
+      sb_ro_set_add(&stack->elems[stack->top - 1], id))
+    return;
+#endif
   assert(stack->top < SB_MAX_STACK_SIZE);
-  stack->elems[stack->top] = (sb_item_t){.kind = kind, .id = id};
+#ifdef SB_POSITION_INDEX
+  sb_stack_index(stack, kind, id);
+#endif
+  stack->elems[stack->top] = sb_item(kind, id);
   stack->top++;
 }
 
-int8_t sb_stack_find(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].kind == kind & stack->elems[i].id == id)
+// Pops the items above index top - 1
+void sb_stack_pop_to(sb_stack_t *stack, int8_t top) {
+  stack->top = top;
+#ifdef SB_STACK_CACHE
+  // forget cached items that were popped
+  int8_t kept = 0;
+  for (int8_t i = 0; (i < SB_CACHE_SIZE) && (i < stack->cache_size); i++) {
+    if (stack->cache_indices[i] < top) {
+      stack->cache_ids[kept] = stack->cache_ids[i];
+      stack->cache_indices[kept] = stack->cache_indices[i];
+      kept++;
+    }
+  }
+  stack->cache_size = kept;
+#endif
+}
+
+// Creates a fresh borrow stack holding the same items as the given stack
+sb_stack_t *sb_stack_clone(sb_stack_t *stack) {
+  sb_stack_t *clone = sb_stack_create();
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++)
+    clone->elems[i] = stack->elems[i];
+  clone->top = stack->top;
+#ifdef SB_POSITION_INDEX
+  sb_stack_reindex(clone);
+#endif
+  return clone;
+}
+
+// Returns the index of the lowest item (kind, id), -1 if there is none
+int8_t sb_stack_find(sb_stack_t *stack, sb_kind_t kind, sb_id_t id)
+    SB_REQUIRES(SB_STACK_VALID(stack))
+    SB_ASSIGNS()
+    SB_ENSURES(-1 <= __CPROVER_return_value &&
+               __CPROVER_return_value < stack->top)
+    SB_ENSURES(__CPROVER_return_value < 0 ||
+               SB_ITEM_AT_IS(stack, __CPROVER_return_value, kind, id))
+    SB_ENSURES(__CPROVER_forall {
+      int j;
+      (0 <= j && j < (__CPROVER_return_value < 0 ? stack->top
+                                                 : __CPROVER_return_value)) ==>
+          !SB_ITEM_AT_IS(stack, j, kind, id)
+    })
+{
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++)
+    SB_ASSIGNS(i)
+    SB_LOOP_INVARIANT(0 <= i && i <= stack->top &&
+                      __CPROVER_forall {
+                        int j;
+                        (0 <= j && j < i) ==> !SB_ITEM_AT_IS(stack, j, kind, id)
+                      })
+    SB_DECREASES(stack->top - i)
+  {
+    if (sb_item_is(stack->elems[i], kind, id))
       return i;
   }
   return -1;
 }
 
+// The borrow stacks covering the bytes of a memory access or borrow
+typedef struct {
+  // pointer to the first stack
+  sb_stack_t **stacks;
+  // number of stacks
+  size_t count;
+} sb_stacks_t;
+
+#ifdef SB_CPROVER_SHADOW
+#ifdef SB_NATIVE
+#error "SB_CPROVER_SHADOW requires CBMC"
+#endif
+#ifdef SB_RANGE_STACKS
+#error "SB_RANGE_STACKS requires shadow maps"
+#endif
+#ifdef SB_FUSED_SHADOW
+#error "SB_FUSED_SHADOW is incompatible with SB_CPROVER_SHADOW"
+#endif
+// Borrow IDs and borrow stacks are kept in CBMC's built-in shadow memory
+// instead of shadow maps, using two shadow fields:
+// - "sb_id" holds the borrow ID of each pointer variable,
+// - "sb_stack" holds 1 + the index in __sb_stack_table of the borrow stack
+//   of each memory location, 0 meaning no stack was created yet.
+// Shadow fields must be scalars, hence the table of stacks.
+// The init functions are macros so that the field declarations are expanded
+// in main by SB_INIT.
+
+// maximum number of borrow stacks
+#ifndef SB_MAX_STACKS
+#define SB_MAX_STACKS 64
+#endif
+
+typedef uint16_t sb_stack_index_t;
+
+#define sb_id_map_init()                                                       \
+  do {                                                                         \
+    __CPROVER_field_decl_local("sb_id", (sb_id_t)0);                           \
+    __CPROVER_field_decl_global("sb_id", (sb_id_t)0);                          \
+  } while (0)
+
+void sb_id_map_set_ptr(void **ptr_to_ptr, sb_id_t id) {
+  sb_gc_track(ptr_to_ptr, __CPROVER_get_field(ptr_to_ptr, "sb_id"));
+  __CPROVER_set_field(ptr_to_ptr, "sb_id", id);
+}
+
+void sb_id_map_set_local(void *address_of_local, sb_id_t id) {
+  sb_gc_track(address_of_local,
+              __CPROVER_get_field(address_of_local, "sb_id"));
+  __CPROVER_set_field(address_of_local, "sb_id", id);
+}
+
+sb_id_t sb_id_map_get_ptr(void **ptr_to_ptr) {
+  return __CPROVER_get_field(ptr_to_ptr, "sb_id");
+}
+
+sb_id_t sb_id_map_get_local(void *address_of_local) {
+  return __CPROVER_get_field(address_of_local, "sb_id");
+}
+
+// Table of all borrow stacks created so far
+sb_stack_t *__sb_stack_table[SB_MAX_STACKS];
+sb_stack_index_t __sb_stack_count = 0;
+
+#define sb_stack_map_init()                                                    \
+  do {                                                                         \
+    __CPROVER_field_decl_local("sb_stack", (sb_stack_index_t)0);               \
+    __CPROVER_field_decl_global("sb_stack", (sb_stack_index_t)0);              \
+  } while (0)
+
+// Gets the borrow stacks associated with the size bytes pointed to by ptr.
+// Stacks are tracked per byte, only the stack of the first byte is used.
+sb_stacks_t sb_stack_map_get(void *ptr, size_t size) {
+  sb_stack_index_t index = __CPROVER_get_field(ptr, "sb_stack");
+  if (!index) {
+    __CPROVER_assert(__sb_stack_count < SB_MAX_STACKS,
+                     "no more than SB_MAX_STACKS borrow stacks");
+    __sb_stack_table[__sb_stack_count] = sb_stack_create();
+    __sb_stack_count++;
+    index = __sb_stack_count;
+    __CPROVER_set_field(ptr, "sb_stack", index);
+  }
+  return (sb_stacks_t){.stacks = &__sb_stack_table[index - 1], .count = 1};
+}
+
+// Declares the size bytes pointed to by ptr as a new object.
+void sb_stack_map_new_object(void *ptr, size_t size) {}
+
+#elif defined(SB_FUSED_SHADOW)
+#ifdef SB_RANGE_STACKS
+#error "SB_FUSED_SHADOW is incompatible with SB_RANGE_STACKS"
+#endif
+// Borrow IDs and borrow stacks share a single shadow map instead of one map
+// each: the shadow of a byte holds the borrow ID of the pointer variable or
+// local starting at that byte and the borrow stack of that byte. Each object
+// is backed by a single shadow object, and the ID and the stack of a local
+// are found with a single lookup.
+typedef struct {
+  sb_id_t id;
+  sb_stack_t *stack;
+} sb_shadow_t;
+
+shadow_map_t __sb_shadow_map;
+
+// Returns the shadow of the byte pointed to by ptr
+sb_shadow_t *sb_shadow_get(void *ptr) {
+  return shadow_map_get(&__sb_shadow_map, ptr);
+}
+
+// Initialises the shared shadow map
+void sb_id_map_init() {
+  shadow_map_init(&__sb_shadow_map, sizeof(sb_shadow_t));
+}
+
+void sb_id_map_set_ptr(void **ptr_to_ptr, sb_id_t id) {
+  sb_shadow_t *shadow = sb_shadow_get(ptr_to_ptr);
+  sb_gc_track(ptr_to_ptr, shadow->id);
+  shadow->id = id;
+}
+
+void sb_id_map_set_local(void *address_of_local, sb_id_t id) {
+  sb_shadow_t *shadow = sb_shadow_get(address_of_local);
+  sb_gc_track(address_of_local, shadow->id);
+  shadow->id = id;
+}
+
+sb_id_t sb_id_map_get_ptr(void **ptr_to_ptr) {
+  return sb_shadow_get(ptr_to_ptr)->id;
+}
+
+sb_id_t sb_id_map_get_local(void *address_of_local) {
+  return sb_shadow_get(address_of_local)->id;
+}
+
+// The stacks live in the shadow map initialised by sb_id_map_init
+void sb_stack_map_init() {}
+
+// Declares the size bytes pointed to by ptr as a new object.
+void sb_stack_map_new_object(void *ptr, size_t size) {}
+
+// Gets the borrow stack held by the shadow of a byte, creating it if needed.
+sb_stacks_t sb_shadow_stacks(sb_shadow_t *shadow) {
+  if (!shadow->stack)
+    shadow->stack = sb_stack_create();
+  return (sb_stacks_t){.stacks = &shadow->stack, .count = 1};
+}
+
+// Gets the borrow stacks associated with the size bytes pointed to by ptr.
+// Stacks are tracked per byte, only the stack of the first byte is used.
+sb_stacks_t sb_stack_map_get(void *ptr, size_t size) {
+  return sb_shadow_stacks(sb_shadow_get(ptr));
+}
+
+#else
 // shadow map that associates a borrow ID to each pointer variable of the
 // program The borrow ID is stored under the object ID of the memory location
 // that contains the pointer variable.
@@ -115,11 +621,15 @@ shadow_map_t __sb_id_map;
 void sb_id_map_init() { shadow_map_init(&__sb_id_map, sizeof(sb_id_t)); }
 
 void sb_id_map_set_ptr(void **ptr_to_ptr, sb_id_t id) {
-  *(sb_id_t *)shadow_map_get(&__sb_id_map, ptr_to_ptr) = id;
+  sb_id_t *shadow_id = shadow_map_get(&__sb_id_map, ptr_to_ptr);
+  sb_gc_track(ptr_to_ptr, *shadow_id);
+  *shadow_id = id;
 }
 
 void sb_id_map_set_local(void *address_of_local, sb_id_t id) {
-  *(sb_id_t *)shadow_map_get(&__sb_id_map, address_of_local) = id;
+  sb_id_t *shadow_id = shadow_map_get(&__sb_id_map, address_of_local);
+  sb_gc_track(address_of_local, *shadow_id);
+  *shadow_id = id;
 }
 
 sb_id_t sb_id_map_get_ptr(void **ptr_to_ptr) {
@@ -130,79 +640,836 @@ sb_id_t sb_id_map_get_local(void *address_of_local) {
   return *(sb_id_t *)shadow_map_get(&__sb_id_map, address_of_local);
 }
 
-// Shadow memory that associates pointers with borrow stacks
+#ifdef SB_RANGE_STACKS
+// Borrow stacks are tracked per range of bytes instead of per byte.
+// Each object is associated with a range map that partitions it into
+// contiguous ranges of bytes sharing the same borrow history, hence the same
+// stack. An object starts as a single range, and a range is only split when
+// an access or a borrow covers part of it, the stack being copied.
+
+// maximum number of ranges per object, ranges grow unbounded natively
+#ifndef SB_MAX_RANGES
+#define SB_MAX_RANGES 16
+#endif
+
+typedef struct {
+  // size of the object
+  size_t size;
+  // number of ranges
+  size_t count;
+  // number of ranges that fit in starts and stacks
+  size_t capacity;
+  // start offset of each range in increasing order, starts[0] is 0
+  size_t *starts;
+  // borrow stack of each range
+  sb_stack_t **stacks;
+} sb_range_map_t;
+
+// Creates a range map made of a single range with an empty stack
+sb_range_map_t *sb_range_map_create(size_t size) {
+  sb_range_map_t *map = __CPROVER_allocate(sizeof(*map), 1);
+  *map = (sb_range_map_t){
+      .size = size,
+      .count = 1,
+      .capacity = SB_MAX_RANGES,
+      .starts = __CPROVER_allocate(SB_MAX_RANGES * sizeof(size_t), 1),
+      .stacks = __CPROVER_allocate(SB_MAX_RANGES * sizeof(sb_stack_t *), 1)};
+  map->stacks[0] = sb_stack_create();
+  return map;
+}
+
+// Makes room for one more range
+void sb_range_map_reserve(sb_range_map_t *map) {
+#ifdef SB_NATIVE
+  if (map->count < map->capacity)
+    return;
+  map->capacity *= 2;
+  map->starts = realloc(map->starts, map->capacity * sizeof(size_t));
+  map->stacks = realloc(map->stacks, map->capacity * sizeof(sb_stack_t *));
+  assert(map->starts && map->stacks);
+#else
+  __CPROVER_assert(map->count < SB_MAX_RANGES,
+                   "no more than SB_MAX_RANGES ranges per object");
+#endif
+}
+
+// Splits the range containing offset so that a range starts at offset,
+// returns the index of that range, or count if offset is past the object.
+size_t sb_range_map_split(sb_range_map_t *map, size_t offset) {
+  size_t i = 0;
+  while (i < map->count && map->starts[i] < offset)
+    i++;
+  if (offset >= map->size || (i < map->count && map->starts[i] == offset))
+    return i;
+  // offset falls strictly inside range i - 1
+  sb_range_map_reserve(map);
+  for (size_t j = map->count; j > i; j--) {
+    map->starts[j] = map->starts[j - 1];
+    map->stacks[j] = map->stacks[j - 1];
+  }
+  map->starts[i] = offset;
+  map->stacks[i] = sb_stack_clone(map->stacks[i - 1]);
+  map->count++;
+  return i;
+}
+
+// Object map that associates a range map with each object
+shadow_map_t __sb_stack_map;
+
+// Initialises the object map of range maps
+void sb_stack_map_init() {
+  shadow_map_init(&__sb_stack_map, sizeof(sb_range_map_t *));
+}
+
+// Declares the size bytes pointed to by ptr as a new object.
+void sb_stack_map_new_object(void *ptr, size_t size) {
+  shadow_map_new_object(&__sb_stack_map, ptr, size);
+}
+
+// Gets the borrow stacks associated with the size bytes pointed to by ptr,
+// splitting ranges so that the stacks cover exactly these bytes.
+sb_stacks_t sb_stack_map_get(void *ptr, size_t size) {
+  size_t offset, object_size;
+  void **slot =
+      shadow_map_get_object(&__sb_stack_map, ptr, &offset, &object_size);
+  if (!slot) {
+    // natively, memory that was never declared as an object
+    sb_stack_map_new_object(ptr, size);
+    slot = shadow_map_get_object(&__sb_stack_map, ptr, &offset, &object_size);
+  }
+  sb_range_map_t *map = *slot;
+  if (!map) {
+    map = sb_range_map_create(object_size);
+    *slot = map;
+  }
+  size_t first = sb_range_map_split(map, offset);
+  size_t last = sb_range_map_split(map, offset + size);
+  return (sb_stacks_t){.stacks = map->stacks + first, .count = last - first};
+}
+
+#else
+// Shadow memory that associates pointers with borrow stacks, one per chunk of
+// SB_GRANULE bytes
 shadow_map_t __sb_stack_map;
 
 // Initialises a shadow map of stack pointers
 void sb_stack_map_init() {
-  shadow_map_init(&__sb_stack_map, sizeof(sb_stack_t *));
+  shadow_map_init_chunks(&__sb_stack_map, sizeof(sb_stack_t *),
+                         SB_GRANULE_BITS);
+}
+
+// Declares the size bytes pointed to by ptr as a new object.
+void sb_stack_map_new_object(void *ptr, size_t size) {}
+
+#if SB_GRANULE > 1
+// The bytes of a chunk share its stack, a borrow or access starting after the
+// first byte of a chunk would use the stack of the bytes before it.
+void sb_granule_check(void *ptr) {
+#ifdef SB_NATIVE
+  // chunks are aligned in the address space
+  assert(((uintptr_t)ptr & (SB_GRANULE - 1)) == 0);
+#else
+  __CPROVER_assert((__CPROVER_POINTER_OFFSET(ptr) & (SB_GRANULE - 1)) == 0,
+                   "borrows and accesses start at a chunk of SB_GRANULE");
+#endif
 }
+#else
+#define sb_granule_check(ptr)
+#endif
 
-// Gets the borrow stack associated with the memory location pointed to by ptr.
-sb_stack_t *sb_stack_get(void *ptr) {
+// Gets the borrow stacks associated with the size bytes pointed to by ptr.
+// Stacks are tracked per chunk, only the stack of the first chunk is used.
+sb_stacks_t sb_stack_map_get(void *ptr, size_t size) {
+  sb_granule_check(ptr);
   sb_stack_t **shadow_stack = shadow_map_get(&__sb_stack_map, ptr);
-  if (!*shadow_stack) {
+  if (!*shadow_stack)
     *shadow_stack = sb_stack_create();
-    (*shadow_stack)->top = 0;
-  }
-  return *shadow_stack;
+  return (sb_stacks_t){.stacks = shadow_stack, .count = 1};
 }
 
+#endif
+#endif
+
 // initialise ghost state for stacked borrows
 #define SB_INIT(symbolic_size, max_stack_size)                                 \
   do {                                                                         \
-    SB_SYMSIZE = symbolic_size;                                                \
+    SB_SYMSIZE = SB_SYMSIZE_ARG(symbolic_size);                                \
+    __CPROVER_assert((max_stack_size) <= INT8_MAX,                             \
+                     "stack indices fit in int8_t");                           \
     SB_MAX_STACK_SIZE = max_stack_size;                                        \
     sb_id_map_init();                                                          \
     sb_stack_map_init();                                                       \
+    sb_stats_init();                                                           \
   } while (0)
 
+////// hybrid tracking //////
+
+// In hybrid mode, selected by initialising with SB_INIT_HYBRID, locals get
+// full borrow stacks while dynamic objects are tracked demonically: each
+// NEW_DYNAMIC nondeterministically becomes the single tracked dynamic object
+// or is ignored, and the rules accept any access to the other dynamic
+// objects. Heap objects no longer multiply the stacks in the formula.
+// Natively every object is tracked.
+
+// track dynamic objects demonically
+bool SB_HYBRID = false;
+
+// the tracked dynamic object, NULL if none
+void *__sb_dynamic_object = NULL;
+
+#define SB_INIT_HYBRID(symbolic_size, max_stack_size)                          \
+  do {                                                                         \
+    SB_INIT(symbolic_size, max_stack_size);                                    \
+    SB_HYBRID = true;                                                          \
+    __sb_dynamic_object = NULL;                                                \
+  } while (0)
+
+// Returns true if ptr points into a dynamic object that is not tracked
+bool sb_hybrid_ignored(void *ptr) {
+#ifdef SB_NATIVE
+  return false;
+#else
+  return SB_HYBRID && __CPROVER_DYNAMIC_OBJECT(ptr) &&
+         !(__sb_dynamic_object &&
+           __CPROVER_same_object(ptr, __sb_dynamic_object));
+#endif
+}
+
+// Gets the borrow stacks associated with the size bytes pointed to by ptr,
+// none if ptr points into a dynamic object that is not tracked.
+sb_stacks_t sb_stacks_get(void *ptr, size_t size) {
+  if (sb_hybrid_ignored(ptr))
+    return (sb_stacks_t){.stacks = NULL, .count = 0};
+  return sb_stack_map_get(ptr, size);
+}
+
+// Gets the borrow stacks associated with the size bytes of a local and stores
+// the borrow ID of the local in id.
+sb_stacks_t sb_stacks_get_local(void *local, size_t size, sb_id_t *id) {
+#ifdef SB_FUSED_SHADOW
+  // one lookup for both
+  sb_shadow_t *shadow = sb_shadow_get(local);
+  *id = shadow->id;
+  if (sb_hybrid_ignored(local))
+    return (sb_stacks_t){.stacks = NULL, .count = 0};
+  return sb_shadow_stacks(shadow);
+#else
+  *id = sb_id_map_get_local(local);
+  return sb_stacks_get(local, size);
+#endif
+}
+
+// Gets the borrow stacks of a new object of size bytes pointed to by ptr,
+// emptied since natively the address may have been used by a dead object.
+sb_stacks_t sb_stacks_init(void *ptr, size_t size) {
+  sb_stack_map_new_object(ptr, size);
+  sb_stacks_t stacks = sb_stack_map_get(ptr, size);
+  for (size_t i = 0; i < stacks.count; i++)
+    sb_stack_pop_to(stacks.stacks[i], 0);
+  return stacks;
+}
+
+// Pushes a borrow item on each of the stacks
+void sb_stacks_push(sb_stacks_t stacks, sb_kind_t kind, sb_id_t id) {
+  for (size_t i = 0; i < stacks.count; i++)
+    sb_stack_push(stacks.stacks[i], kind, id);
+}
+
+#ifdef SB_STACK_CACHE
+// Items are searched through a per stack cache of recently found tags.
+// Tags other than __sb_id_bottom appear at most once in a stack, which makes
+// the top of the stack a valid fast path for them. For __sb_id_bottom the
+// cache holds the lowest SB_SHARED_RW item, which stays the lowest until it
+// gets popped since items are only pushed above it.
+
+// cache statistics, only counted natively where sb_stack_cache_report prints
+// them, so that they add no writes to the formula
+#ifdef SB_NATIVE
+size_t __sb_cache_top_hits = 0;
+size_t __sb_cache_hits = 0;
+size_t __sb_cache_misses = 0;
+#define SB_CACHE_COUNT(counter) (counter)++
+#else
+#define SB_CACHE_COUNT(counter)
+#endif
+
+// Caches the index of the lowest item tagged with id, evicting the least
+// recently cached entry if the cache is full
+void sb_stack_cache_insert(sb_stack_t *stack, sb_id_t id, int8_t index) {
+  int8_t size = stack->cache_size < SB_CACHE_SIZE ? stack->cache_size
+                                                  : SB_CACHE_SIZE - 1;
+  for (int8_t i = size; i > 0; i--) {
+    stack->cache_ids[i] = stack->cache_ids[i - 1];
+    stack->cache_indices[i] = stack->cache_indices[i - 1];
+  }
+  stack->cache_ids[0] = id;
+  stack->cache_indices[0] = index;
+  stack->cache_size = size + 1;
+}
+
+// Returns the index of the lowest item tagged with id, -1 if there is none
+int8_t sb_stack_lookup(sb_stack_t *stack, sb_id_t id) {
+  if (id != __sb_id_bottom && stack->top > 0 &&
+      sb_item_id(stack->elems[stack->top - 1]) == id) {
+    SB_CACHE_COUNT(__sb_cache_top_hits);
+    return stack->top - 1;
+  }
+  for (int8_t i = 0; (i < SB_CACHE_SIZE) && (i < stack->cache_size); i++) {
+    if (stack->cache_ids[i] == id) {
+      SB_CACHE_COUNT(__sb_cache_hits);
+      return stack->cache_indices[i];
+    }
+  }
+  SB_CACHE_COUNT(__sb_cache_misses);
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (sb_item_id(stack->elems[i]) == id) {
+      sb_stack_cache_insert(stack, id, i);
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Looks for the item (kind, id) from the bottom of the stack and pops anything
+// above it. Returns false if the item is not in the stack.
+bool sb_stack_use(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+  int8_t i = sb_stack_lookup(stack, id);
+  if (i < 0 || sb_item_kind(stack->elems[i]) != kind)
+    return false;
+  sb_stack_pop_to(stack, i + 1);
+  return true;
+}
+
+// Looks for an item tagged with id from the bottom of the stack and pops
+// anything above it but the SB_SHARED_RO items directly above it.
+// Returns false if no item is tagged with id.
+bool sb_stack_read1(sb_stack_t *stack, sb_id_t id) {
+  int8_t new_top = sb_stack_lookup(stack, id);
+  if (new_top < 0)
+    return false;
+  while (new_top + 1 < stack->top &&
+         sb_item_kind(stack->elems[new_top + 1]) == SB_SHARED_RO)
+    new_top++;
+  sb_stack_pop_to(stack, new_top + 1);
+  return true;
+}
+
+#ifdef SB_NATIVE
+// Prints the cache statistics
+void sb_stack_cache_report() {
+  size_t hits = __sb_cache_top_hits + __sb_cache_hits;
+  size_t total = hits + __sb_cache_misses;
+  fprintf(stderr,
+          "stack cache: %zu top hits, %zu cache hits, %zu misses, "
+          "hit rate %.1f%%\n",
+          __sb_cache_top_hits, __sb_cache_hits, __sb_cache_misses,
+          total ? 100.0 * hits / total : 0.0);
+}
+#define sb_stats_init() atexit(sb_stack_cache_report)
+#endif
+
+#elif defined(SB_RO_SETS)
+// Looks for the item (kind, id) from the bottom of the stack and pops anything
+// above it, including its set. Returns false if the item is not in the stack.
+bool sb_stack_use(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (sb_item_is(stack->elems[i], kind, id)) {
+      stack->elems[i].ro_mask = 0;
+      sb_stack_pop_to(stack, i + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Looks for an item or a set holding id from the bottom of the stack and pops
+// anything above it but the SB_SHARED_RO items directly above it. The set of
+// the item is kept whole since all its tags sit directly above the item.
+// Returns false if id is not in the stack.
+bool sb_stack_read1(sb_stack_t *stack, sb_id_t id) {
+  bool found = false;
+  int8_t new_top = -1;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (!found) {
+      found = sb_item_id(stack->elems[i]) == id ||
+              sb_ro_set_contains(&stack->elems[i], id);
+      new_top = i;
+    } else {
+      if (sb_item_kind(stack->elems[i]) == SB_SHARED_RO) {
+        new_top = i;
+      } else {
+        break;
+      }
+    }
+  }
+  if (found)
+    sb_stack_pop_to(stack, new_top + 1);
+  return found;
+}
+
+#elif defined(SB_QUANTIFIERS)
+#if defined(SB_NATIVE) || defined(SB_PACKED_ITEMS) || defined(SB_CONTRACTS)
+#error "SB_QUANTIFIERS requires CBMC, plain items and no contracts"
+#endif
+// The rules are loop free: the index of the item found and the new top of the
+// stack are picked nondeterministically and constrained with quantifiers over
+// elems, so that the formula of an access does not grow with
+// SB_MAX_STACK_SIZE. Only the SMT back ends (--smt2) handle these quantifiers.
+
+int8_t nondet_int8_t();
+
+// Looks for the item (kind, id) from the bottom of the stack and pops anything
+// above it. Returns false if the item is not in the stack.
+bool sb_stack_use(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+  int8_t top = stack->top;
+  sb_item_t *elems = stack->elems;
+  bool found = __CPROVER_exists {
+    int j;
+    (0 <= j && j < top) && elems[j].kind == kind && elems[j].id == id
+  };
+  if (!found)
+    return false;
+  // the lowest item (kind, id)
+  int8_t i = nondet_int8_t();
+  __CPROVER_assume(0 <= i && i < top && elems[i].kind == kind &&
+                   elems[i].id == id);
+  __CPROVER_assume(__CPROVER_forall {
+    int j;
+    (0 <= j && j < i) ==> !(elems[j].kind == kind && elems[j].id == id)
+  });
+  sb_stack_pop_to(stack, i + 1);
+  return true;
+}
+
+// Looks for an item tagged with id from the bottom of the stack and pops
+// anything above it but the SB_SHARED_RO items directly above it.
+// Returns false if no item is tagged with id.
+bool sb_stack_read1(sb_stack_t *stack, sb_id_t id) {
+  int8_t top = stack->top;
+  sb_item_t *elems = stack->elems;
+  bool found = __CPROVER_exists {
+    int j;
+    (0 <= j && j < top) && elems[j].id == id
+  };
+  if (!found)
+    return false;
+  // the lowest item tagged with id
+  int8_t i = nondet_int8_t();
+  __CPROVER_assume(0 <= i && i < top && elems[i].id == id);
+  __CPROVER_assume(__CPROVER_forall {
+    int j;
+    (0 <= j && j < i) ==> elems[j].id != id
+  });
+  // the end of the run of SB_SHARED_RO items above it
+  int8_t new_top = nondet_int8_t();
+  __CPROVER_assume(i < new_top && new_top <= top &&
+                   (new_top == top || elems[new_top].kind != SB_SHARED_RO));
+  __CPROVER_assume(__CPROVER_forall {
+    int j;
+    (i < j && j < new_top) ==> elems[j].kind == SB_SHARED_RO
+  });
+  sb_stack_pop_to(stack, new_top);
+  return true;
+}
+
+#elif defined(SB_POSITION_INDEX)
+// Looks for the item (kind, id) in the position index and pops anything
+// above it. Returns false if the item is not in the stack.
+bool sb_stack_use(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
+  int8_t i = sb_stack_position(stack, id);
+  if (i < 0 || sb_item_kind(stack->elems[i]) != kind)
+    return false;
+  sb_stack_pop_to(stack, i + 1);
+  return true;
+}
+
+#ifndef SB_NATIVE
+int8_t nondet_int8_t();
+#endif
+
+// Returns the index of the first item above index i that is not
+// SB_SHARED_RO, top if there is none
+int8_t sb_stack_ro_run_end(sb_stack_t *stack, int8_t i) {
+#ifdef SB_NATIVE
+  int8_t end = i + 1;
+  while (end < stack->top &&
+         sb_item_kind(stack->elems[end]) == SB_SHARED_RO)
+    end++;
+  return end;
+#else
+  // the items between i and end are SB_SHARED_RO exactly when the highest
+  // item below end that is not is at most i, so end is checked in constant
+  // time instead of scanning
+  int8_t end = nondet_int8_t();
+  __CPROVER_assume(i < end && end <= stack->top &&
+                   stack->non_ro[end - 1] <= i &&
+                   (end == stack->top ||
+                    sb_item_kind(stack->elems[end]) != SB_SHARED_RO));
+  return end;
+#endif
+}
+
+// Looks for an item tagged with id in the position index and pops anything
+// above it but the SB_SHARED_RO items directly above it.
+// Returns false if no item is tagged with id.
+bool sb_stack_read1(sb_stack_t *stack, sb_id_t id) {
+  int8_t i = sb_stack_position(stack, id);
+  if (i < 0)
+    return false;
+  sb_stack_pop_to(stack, sb_stack_ro_run_end(stack, i));
+  return true;
+}
+
+#else
+// Looks for the item (kind, id) from the bottom of the stack and pops anything
+// above it. Returns false if the item is not in the stack.
+bool sb_stack_use(sb_stack_t *stack, sb_kind_t kind, sb_id_t id)
+    SB_REQUIRES(SB_STACK_VALID(stack))
+    SB_ASSIGNS(stack->top)
+    SB_ENSURES(__CPROVER_return_value == __CPROVER_exists {
+      int j;
+      (0 <= j && j < __CPROVER_old(stack->top)) &&
+          SB_ITEM_AT_IS(stack, j, kind, id)
+    })
+    SB_ENSURES(!__CPROVER_return_value ==>
+               stack->top == __CPROVER_old(stack->top))
+    SB_ENSURES(__CPROVER_return_value ==>
+               (0 < stack->top && stack->top <= __CPROVER_old(stack->top) &&
+                SB_ITEM_AT_IS(stack, stack->top - 1, kind, id) &&
+                __CPROVER_forall {
+                  int j;
+                  (0 <= j && j < stack->top - 1) ==>
+                      !SB_ITEM_AT_IS(stack, j, kind, id)
+                }))
+{
+  int8_t i = sb_stack_find(stack, kind, id);
+  if (i < 0)
+    return false;
+  sb_stack_pop_to(stack, i + 1);
+  return true;
+}
+
+// Looks for an item tagged with id from the bottom of the stack and pops
+// anything above it but the SB_SHARED_RO items directly above it.
+// Returns false if no item is tagged with id.
+// In the contract, every item above an item tagged with id is SB_SHARED_RO
+// and the item at the new top, if any, is not.
+bool sb_stack_read1(sb_stack_t *stack, sb_id_t id)
+    SB_REQUIRES(SB_STACK_VALID(stack))
+    SB_ASSIGNS(stack->top)
+    SB_ENSURES(__CPROVER_return_value == __CPROVER_exists {
+      int j;
+      (0 <= j && j < __CPROVER_old(stack->top)) && stack->elems[j].id == id
+    })
+    SB_ENSURES(!__CPROVER_return_value ==>
+               stack->top == __CPROVER_old(stack->top))
+    SB_ENSURES(__CPROVER_return_value ==>
+               (0 < stack->top && stack->top <= __CPROVER_old(stack->top) &&
+                (stack->top == __CPROVER_old(stack->top) ||
+                 stack->elems[stack->top].kind != SB_SHARED_RO) &&
+                __CPROVER_exists {
+                  int j;
+                  (0 <= j && j < stack->top) && stack->elems[j].id == id
+                } &&
+                __CPROVER_forall {
+                  int l;
+                  __CPROVER_forall {
+                    int j;
+                    (0 <= l && l < j && j < stack->top &&
+                     stack->elems[l].id == id) ==>
+                        stack->elems[j].kind == SB_SHARED_RO
+                  }
+                }))
+{
+  bool found = false;
+  int8_t new_top = -1;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++)
+    SB_ASSIGNS(i, found, new_top)
+    SB_LOOP_INVARIANT(
+        0 <= i && i <= stack->top && new_top == i - 1 &&
+        (found == __CPROVER_exists {
+          int j;
+          (0 <= j && j < i) && stack->elems[j].id == id
+        }) &&
+        __CPROVER_forall {
+          int l;
+          __CPROVER_forall {
+            int j;
+            (0 <= l && l < j && j < i && stack->elems[l].id == id) ==>
+                stack->elems[j].kind == SB_SHARED_RO
+          }
+        })
+    SB_DECREASES(stack->top - i)
+  {
+    if (!found) {
+      found = sb_item_id(stack->elems[i]) == id;
+      new_top = i;
+    } else {
+      if (sb_item_kind(stack->elems[i]) == SB_SHARED_RO) {
+        new_top = i;
+      } else {
+        break;
+      }
+    }
+  }
+  if (found)
+    sb_stack_pop_to(stack, new_top + 1);
+  return found;
+}
+
+#ifndef SB_CONTRACTS
+// Reborrow of kind through used_id: READ-1 for a shared reference, USE-2
+// otherwise, then a push of (kind, new_id). The scan of the rule gives the new
+// top, the item is written right above it without another pass.
+bool sb_stack_reborrow(sb_stack_t *stack, sb_id_t used_id, sb_kind_t kind,
+                       sb_id_t new_id) {
+  bool read = kind == SB_SHARED_RO;
+  sb_kind_t used_kind =
+      (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
+  bool found = false;
+  int8_t new_top = -1;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (!found) {
+      found = read ? sb_item_id(stack->elems[i]) == used_id
+                   : sb_item_is(stack->elems[i], used_kind, used_id);
+      new_top = i;
+    } else if (read && sb_item_kind(stack->elems[i]) == SB_SHARED_RO) {
+      new_top = i;
+    } else {
+      break;
+    }
+  }
+  if (!found)
+    return false;
+  assert(new_top + 1 < SB_MAX_STACK_SIZE);
+  stack->elems[new_top + 1] = sb_item(kind, new_id);
+  sb_stack_pop_to(stack, new_top + 2);
+  return true;
+}
+#define SB_STACK_REBORROW_DEFINED
+#endif
+
+#endif
+
+#ifndef SB_STACK_REBORROW_DEFINED
+// Reborrow of kind through used_id: READ-1 for a shared reference, USE-2
+// otherwise, then a push of (kind, new_id).
+bool sb_stack_reborrow(sb_stack_t *stack, sb_id_t used_id, sb_kind_t kind,
+                       sb_id_t new_id) {
+  bool found;
+  if (kind == SB_SHARED_RO)
+    found = sb_stack_read1(stack, used_id);
+  else
+    found = sb_stack_use(
+        stack, (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE,
+        used_id);
+  if (found)
+    sb_stack_push(stack, kind, new_id);
+  return found;
+}
+#endif
+
+#ifndef sb_stats_init
+#define sb_stats_init()
+#endif
+
+// Applies sb_stack_use to each of the stacks
+bool sb_stacks_use(sb_stacks_t stacks, sb_kind_t kind, sb_id_t id) {
+  bool result = true;
+  for (size_t i = 0; i < stacks.count; i++)
+    result = sb_stack_use(stacks.stacks[i], kind, id) && result;
+  return result;
+}
+
+// Applies sb_stack_read1 to each of the stacks
+bool sb_stacks_read1(sb_stacks_t stacks, sb_id_t id) {
+  bool result = true;
+  for (size_t i = 0; i < stacks.count; i++)
+    result = sb_stack_read1(stacks.stacks[i], id) && result;
+  return result;
+}
+
+// Applies sb_stack_reborrow to each of the stacks
+bool sb_stacks_reborrow(sb_stacks_t stacks, sb_id_t used_id, sb_kind_t kind,
+                        sb_id_t new_id) {
+  bool result = true;
+  for (size_t i = 0; i < stacks.count; i++)
+    result = sb_stack_reborrow(stacks.stacks[i], used_id, kind, new_id) &&
+             result;
+  return result;
+}
+
+////// garbage collection of dead tags //////
+
+// Stacks only shrink when accesses pop items, so items of tags that no
+// pointer holds anymore pile up. Compiling with -DSB_TAG_GC enables SB_GC(),
+// which removes these items from all stacks, natively it also runs every
+// SB_GC_PERIOD fresh tags. A tag is live while a memory location holds it in
+// the id map, STORAGE_DEAD(ptr) ends the lifetime of a pointer variable.
+
+#define STORAGE_DEAD(ptr) sb_id_map_set_ptr((void **)&ptr, __sb_id_null)
+
+#ifdef SB_TAG_GC
+#define SB_GC() sb_gc()
+
+// Removes the items of dead tags from the stack. The bottom item and
+// __sb_id_bottom items are kept, as well as dead items that are not
+// SB_SHARED_RO and sit below a kept SB_SHARED_RO item: READ-1 stops at
+// them, removing them would keep the SB_SHARED_RO items alive longer.
+// With SB_RO_SETS dead tags are also removed from the sets.
+void sb_stack_compact(sb_stack_t *stack, bool *live) {
+  // kind of the closest kept item above, 0 if none
+  sb_kind_t above = 0;
+  for (int8_t i = stack->top - 1; i >= 0; i--) {
+#ifdef SB_RO_SETS
+    // the set sits right above the item, drop its dead tags first
+    sb_item_t *set = &stack->elems[i];
+    for (int8_t b = 0; set->ro_mask && b < SB_RO_SET_BITS; b++) {
+      sb_ro_mask_t bit = (sb_ro_mask_t)1 << b;
+      if ((set->ro_mask & bit) && !live[set->ro_base + b])
+        set->ro_mask &= ~bit;
+    }
+    if (set->ro_mask) {
+      above = SB_SHARED_RO;
+      // a dead SB_SHARED_RO item holding a set is kept with it
+      if (set->kind == SB_SHARED_RO)
+        continue;
+    }
+#endif
+    if (i == 0)
+      break;
+    sb_item_t item = stack->elems[i];
+    sb_kind_t kind = sb_item_kind(item);
+    sb_id_t id = sb_item_id(item);
+    bool dead = id != __sb_id_bottom && !live[id];
+    if (dead && (kind == SB_SHARED_RO || above != SB_SHARED_RO))
+      stack->elems[i] = sb_item(0, id);
+    else
+      above = kind;
+  }
+  int8_t top = 0;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (sb_item_kind(stack->elems[i])) {
+      stack->elems[top] = stack->elems[i];
+      top++;
+    }
+  }
+  stack->top = top;
+#ifdef SB_STACK_CACHE
+  // items moved
+  stack->cache_size = 0;
+#endif
+#ifdef SB_POSITION_INDEX
+  sb_stack_reindex(stack);
+#endif
+}
+
+// Removes the items of dead tags from all stacks
+void sb_gc() {
+  bool *live = __CPROVER_allocate(__sb_id_fresh * sizeof(bool), 1);
+  // mark the tags held in the id map, forgetting the slots that hold none
+  sb_slot_t **link = &__sb_slots;
+  while (*link) {
+    sb_slot_t *slot = *link;
+    sb_id_t id = sb_id_map_get_local(slot->addr);
+    if (id == __sb_id_null) {
+      *link = slot->next;
+#ifdef SB_NATIVE
+      free(slot);
+#endif
+      continue;
+    }
+    if (id != __sb_id_bottom)
+      live[id] = true;
+    link = &slot->next;
+  }
+  // sweep the stacks
+  for (sb_stack_t *stack = __sb_stacks; stack; stack = stack->next)
+    sb_stack_compact(stack, live);
+#ifdef SB_NATIVE
+  free(live);
+#endif
+}
+#else
+#define SB_GC()
+#endif
+
 ////// stacked borrows rules from the paper //////
 
+// The rule macros pass the size of the borrowed or accessed memory, given by
+// the type of the local or of the pointee. Stacks tracked per byte only use
+// the first byte, range stacks use all of them.
+
 // Initialises the borrow stack for a local object by creating the borrow stack
 // in the map and pushing a SB_UNIQUE on that stack. The local variable
 // owns itself and a direct write to the variable is treated like a write
 // through a mutable ref.
-#define NEW_LOCAL(local) sb_new_local(&local)
-void sb_new_local(void *ptr) {
+#define NEW_LOCAL(local) sb_new_local(&local, sizeof(local))
+void sb_new_local(void *ptr, size_t size) {
   sb_id_t fresh_id = sb_id_fresh();
+#ifdef SB_RANGE_STACKS
+  // any part of the local can be accessed directly, e.g. an array cell
+  for (size_t i = 0; i < size; i++)
+    sb_id_map_set_local((uint8_t *)ptr + i, fresh_id);
+#else
   sb_id_map_set_local(ptr, fresh_id);
-  sb_stack_push(sb_stack_get(ptr), SB_UNIQUE, fresh_id);
+#endif
+  sb_stacks_push(sb_stacks_init(ptr, size), SB_UNIQUE, fresh_id);
 }
 
+#ifdef SB_NATIVE
+#define __sb_dynamic_size(ptr) sb_native_dynamic_size(ptr)
+#else
+#define __sb_dynamic_size(ptr)                                                 \
+  (__CPROVER_OBJECT_SIZE(ptr) - __CPROVER_POINTER_OFFSET(ptr))
+#endif
+
 // Initialises the borrow stack for the dynamic object pointed to by
 // the pointer variable pointed to by ptr. Dynamic objects are anonymous
 // and can only be referred to throught the pointer variable that received
 // the fresh pointer value. That pointer variable uniquely owns the object.
-#define NEW_DYNAMIC(ptr) sb_new_dynamic(&ptr)
-void sb_new_dynamic(void **ptr) {
+#define NEW_DYNAMIC(ptr)                                                       \
+  sb_new_dynamic((void **)&ptr, __sb_dynamic_size(ptr))
+void sb_new_dynamic(void **ptr, size_t size) {
+#ifdef SB_NATIVE
+  __CPROVER_assert(size > 0, "NEW_DYNAMIC of an object allocated by malloc, "
+                             "calloc or realloc");
+#else
+  if (SB_HYBRID) {
+    // decide nondeterministically to track this object
+    if (nondet_size_t())
+      return;
+    __sb_dynamic_object = *ptr;
+  }
+#endif
   sb_id_t fresh_id = sb_id_fresh();
   sb_id_map_set_ptr(ptr, fresh_id);
-  sb_stack_push(sb_stack_get(*ptr), SB_UNIQUE, fresh_id);
+  sb_stacks_push(sb_stacks_init(*ptr, size), SB_UNIQUE, fresh_id);
 }
 
 #define UNIQUE_FROM_LOCAL(new_ref, local)                                      \
-  sb_new_mut_from_local(&new_ref, &local)
+  sb_new_mut_from_local((void **)&new_ref, &local, sizeof(*new_ref))
 
 // Models the creation of a new mutable reference created from the address of a
 // local variable.
-void sb_new_mut_from_local(void **new_ref, void *local) {
-  sb_id_t old_id = sb_id_map_get_local(local);
+void sb_new_mut_from_local(void **new_ref, void *local, size_t size) {
+  sb_id_t old_id;
+  sb_stacks_t stacks = sb_stacks_get_local(local, size, &old_id);
   sb_id_t new_id = sb_id_fresh();
   sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(local), SB_UNIQUE, new_id);
+  sb_stacks_push(stacks, SB_UNIQUE, new_id);
 }
 
 #define UNIQUE_FROM_REF(new_ref, old_ref)                                      \
-  sb_new_mut_from_ref(&new_ref, &old_ref)
+  sb_new_mut_from_ref((void **)&new_ref, (void **)&old_ref, sizeof(*new_ref))
 
 // Models a new mutable reference created by borrowing an existing reference.
 // let &mut y = x;
-void sb_new_mut_from_ref(void **new_ref, void **old_ref) {
+void sb_new_mut_from_ref(void **new_ref, void **old_ref, size_t size) {
   sb_id_t old_id = sb_id_map_get_ptr(old_ref);
   sb_id_t new_id = sb_id_fresh();
   sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(*old_ref), SB_UNIQUE, new_id);
+  sb_stacks_push(sb_stacks_get(*old_ref, size), SB_UNIQUE, new_id);
 }
 
 // USE-1 Rule from the paper. Triggered when a memory location is updated
@@ -217,63 +1484,51 @@ void sb_new_mut_from_ref(void **new_ref, void **old_ref) {
 
 #define USE1_LOCAL(used)                                                       \
   do {                                                                         \
-    bool result = sb_use1_local(&used);                                        \
+    bool result = sb_use1_local(&used, sizeof(used));                          \
     __CPROVER_assert(result, "USE1 " #used);                                   \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_use1_local(void *used) {
-  sb_id_t used_id = sb_id_map_get_local(used);
-  sb_stack_t *stack = sb_stack_get(used);
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].id == used_id && stack->elems[i].kind == SB_UNIQUE) {
-      stack->top = i + 1;
-      return true;
-    }
-  }
-  return false;
+bool sb_use1_local(void *used, size_t size) {
+  sb_id_t used_id;
+  sb_stacks_t stacks = sb_stacks_get_local(used, size, &used_id);
+  return sb_stacks_use(stacks, SB_UNIQUE, used_id);
 }
 
 #define USE1(used)                                                             \
   do {                                                                         \
-    bool result = sb_use1(&used);                                              \
+    bool result = sb_use1((void **)&used, sizeof(*used));                      \
     __CPROVER_assert(result, "USE1 " #used);                                   \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_use1(void **used) {
+bool sb_use1(void **used, size_t size) {
   sb_id_t used_id = sb_id_map_get_ptr(used);
-  sb_stack_t *stack = sb_stack_get(*used);
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].id == used_id && stack->elems[i].kind == SB_UNIQUE) {
-      stack->top = i + 1;
-      return true;
-    }
-  }
-  return false;
+  return sb_stacks_use(sb_stacks_get(*used, size), SB_UNIQUE, used_id);
 }
 
 #define SHARED_RW_FROM_LOCAL(new_raw, local)                                   \
-  sb_new_raw_from_local(&new_raw, &local)
+  sb_new_raw_from_local((void **)&new_raw, &local, sizeof(*new_raw))
 
 // New raw pointer from the address of a local variable.
-void sb_new_raw_from_local(void **new_raw, void *local) {
+void sb_new_raw_from_local(void **new_raw, void *local, size_t size) {
   sb_id_map_set_ptr(new_raw, __sb_id_bottom);
-  sb_stack_push(sb_stack_get(local), SB_SHARED_RW, __sb_id_bottom);
+  sb_stacks_push(sb_stacks_get(local, size), SB_SHARED_RW, __sb_id_bottom);
 }
 
 #define SHARED_RW_FROM_REF(new_raw, old_ref)                                   \
-  sb_new_raw_from_ref(&new_raw, &old_ref)
+  sb_new_raw_from_ref((void **)&new_raw, (void **)&old_ref, sizeof(*new_raw))
 
 // New raw pointer from a reference.
-void sb_new_raw_from_ref(void **new_raw, void **old_ref) {
+void sb_new_raw_from_ref(void **new_raw, void **old_ref, size_t size) {
   sb_id_map_set_ptr(new_raw, __sb_id_bottom);
-  sb_stack_push(sb_stack_get(*old_ref), SB_SHARED_RW, __sb_id_bottom);
+  sb_stacks_push(sb_stacks_get(*old_ref, size), SB_SHARED_RW, __sb_id_bottom);
 }
 
-#define TRANSMUTE_REF(new_ref, old_ref) sb_transmute_ref(&new_ref, &old_ref)
+#define TRANSMUTE_REF(new_ref, old_ref)                                        \
+  sb_transmute_ref((void **)&new_ref, (void **)&old_ref)
 
 // Transmuting a ref to another ref copies the borrow id but does not modify
 // the stack.
@@ -287,64 +1542,51 @@ void sb_transmute_ref(void **new_ref, void **old_ref) {
 
 #define USE2_LOCAL(used)                                                       \
   do {                                                                         \
-    bool result = sb_use2_local(&used);                                        \
+    bool result = sb_use2_local(&used, sizeof(used));                          \
     __CPROVER_assert(result, "USE2 " #used);                                   \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_use2_local(void *used) {
-  sb_id_t used_id = sb_id_map_get_local(used);
+bool sb_use2_local(void *used, size_t size) {
+  sb_id_t used_id;
+  sb_stacks_t stacks = sb_stacks_get_local(used, size, &used_id);
   sb_kind_t kind = (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
-  sb_stack_t *stack = sb_stack_get(used);
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].id == used_id && stack->elems[i].kind == kind) {
-      stack->top = i + 1;
-      return true;
-    }
-  }
-  return false;
+  return sb_stacks_use(stacks, kind, used_id);
 }
 
 #define USE2(used)                                                             \
   do {                                                                         \
-    bool result = sb_use2(&used);                                              \
+    bool result = sb_use2((void **)&used, sizeof(*used));                      \
     __CPROVER_assert(result, "USE2 " #used);                                   \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_use2(void **used) {
+bool sb_use2(void **used, size_t size) {
   sb_id_t used_id = sb_id_map_get_ptr(used);
   sb_kind_t kind = (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
-  sb_stack_t *stack = sb_stack_get(*used);
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].id == used_id && stack->elems[i].kind == kind) {
-      stack->top = i + 1;
-      return true;
-    }
-  }
-  return false;
+  return sb_stacks_use(sb_stacks_get(*used, size), kind, used_id);
 }
 
 #define SHARED_RO_FROM_LOCAL(new_ref, local)                                   \
-  sb_new_shared_from_local(&new_ref, &local)
+  sb_new_shared_from_local((void **)&new_ref, &local, sizeof(*new_ref))
 
 // New mutable reference created from the address of a stack variable.
-void sb_new_shared_from_local(void **new_ref, void *local) {
+void sb_new_shared_from_local(void **new_ref, void *local, size_t size) {
   sb_id_t new_id = sb_id_fresh();
   sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(local), SB_SHARED_RO, new_id);
+  sb_stacks_push(sb_stacks_get(local, size), SB_SHARED_RO, new_id);
 }
 
 #define SHARED_RO_FROM_REF(new_ref, old_ref)                                   \
-  sb_new_shared_from_ref(&new_ref, &old_ref)
+  sb_new_shared_from_ref((void **)&new_ref, (void **)&old_ref, sizeof(*new_ref))
 
 // New mutable reference created by copying an existing reference.
-void sb_new_shared_from_ref(void **new_ref, void **old_ref) {
+void sb_new_shared_from_ref(void **new_ref, void **old_ref, size_t size) {
   sb_id_t new_id = sb_id_fresh();
   sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(*old_ref), SB_SHARED_RO, new_id);
+  sb_stacks_push(sb_stacks_get(*old_ref, size), SB_SHARED_RO, new_id);
 }
 
 // READ-1 Rule from the paper. Check that the used borrow id in the stack
@@ -355,62 +1597,111 @@ void sb_new_shared_from_ref(void **new_ref, void **old_ref) {
 
 #define READ1_LOCAL(used)                                                      \
   do {                                                                         \
-    bool result = sb_read1_local(&used);                                       \
+    bool result = sb_read1_local(&used, sizeof(used));                         \
     __CPROVER_assert(result, "READ1 " #used);                                  \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_read1_local(void *used) {
-  sb_id_t used_id = sb_id_map_get_local(used);
-  sb_stack_t *stack = sb_stack_get(used);
-  bool found = false;
-  int8_t new_top = -1;
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (!found) {
-      found = stack->elems[i].id == used_id;
-      new_top = i;
-    } else {
-      if (stack->elems[i].kind == SB_SHARED_RO) {
-        new_top = i;
-      } else {
-        break;
-      }
-    }
-  }
-  if (found)
-    stack->top = new_top + 1;
-  return found;
+bool sb_read1_local(void *used, size_t size) {
+  sb_id_t used_id;
+  sb_stacks_t stacks = sb_stacks_get_local(used, size, &used_id);
+  return sb_stacks_read1(stacks, used_id);
 }
 
 #define READ1(used)                                                            \
   do {                                                                         \
-    bool result = sb_read1(&used);                                             \
+    bool result = sb_read1((void **)&used, sizeof(*used));                     \
     __CPROVER_assert(result, "READ1 " #used);                                  \
     if (!result)                                                               \
       __CPROVER_assume(false);                                                 \
   } while (0)
 
-bool sb_read1(void **used) {
+bool sb_read1(void **used, size_t size) {
   sb_id_t used_id = sb_id_map_get_ptr(used);
-  sb_stack_t *stack = sb_stack_get(*used);
-  bool found = false;
-  int8_t new_top = -1;
-  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (!found) {
-      found = stack->elems[i].id == used_id;
-      new_top = i;
-    } else {
-      if (stack->elems[i].kind == SB_SHARED_RO) {
-        new_top = i;
-      } else {
-        break;
-      }
-    }
-  }
-  if (found)
-    stack->top = new_top + 1;
-  return found;
+  return sb_stacks_read1(sb_stacks_get(*used, size), used_id);
 }
 
+////// fused reborrows //////
+
+// Harnesses check the borrowed reference before each reborrow, e.g.
+// READ1(x); SHARED_RO_FROM_REF(y, x);. The fused macros do both with a single
+// lookup of the tag and of the stacks and a single pass over each stack:
+// - REBORROW_MUT(y, x) is USE2(x); UNIQUE_FROM_REF(y, x);
+// - REBORROW_SHARED(y, x) is READ1(x); SHARED_RO_FROM_REF(y, x);
+// - REBORROW_RAW(y, x) is USE2(x); SHARED_RW_FROM_REF(y, x);
+// and the _LOCAL variants borrow a local instead of a reference. The access
+// covers the bytes of the new reference, like the reborrow does.
+
+#define SB_REBORROW_ASSERT(result, rule, used)                                 \
+  do {                                                                         \
+    bool __sb_result = (result);                                               \
+    __CPROVER_assert(__sb_result, rule " " #used);                             \
+    if (!__sb_result)                                                          \
+      __CPROVER_assume(false);                                                 \
+  } while (0)
+
+#define REBORROW_MUT_LOCAL(new_ref, local)                                     \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local((void **)&new_ref, &local,         \
+                                            SB_UNIQUE, sizeof(*new_ref)),      \
+                     "USE2", local)
+
+#define REBORROW_SHARED_LOCAL(new_ref, local)                                  \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local((void **)&new_ref, &local,         \
+                                            SB_SHARED_RO, sizeof(*new_ref)),   \
+                     "READ1", local)
+
+#define REBORROW_RAW_LOCAL(new_raw, local)                                     \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local((void **)&new_raw, &local,         \
+                                            SB_SHARED_RW, sizeof(*new_raw)),   \
+                     "USE2", local)
+
+// Reborrow of kind from the address of a local variable.
+bool sb_reborrow_from_local(void **new_ref, void *local, sb_kind_t kind,
+                            size_t size) {
+  sb_id_t used_id;
+  sb_stacks_t stacks = sb_stacks_get_local(local, size, &used_id);
+  sb_id_t new_id = (kind == SB_SHARED_RW) ? __sb_id_bottom : sb_id_fresh();
+  sb_id_map_set_ptr(new_ref, new_id);
+  return sb_stacks_reborrow(stacks, used_id, kind, new_id);
+}
+
+#define REBORROW_MUT(new_ref, old_ref)                                         \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref((void **)&new_ref,                   \
+                                          (void **)&old_ref, SB_UNIQUE,        \
+                                          sizeof(*new_ref)),                   \
+                     "USE2", old_ref)
+
+#define REBORROW_SHARED(new_ref, old_ref)                                      \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref((void **)&new_ref,                   \
+                                          (void **)&old_ref, SB_SHARED_RO,     \
+                                          sizeof(*new_ref)),                   \
+                     "READ1", old_ref)
+
+#define REBORROW_RAW(new_raw, old_ref)                                         \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref((void **)&new_raw,                   \
+                                          (void **)&old_ref, SB_SHARED_RW,     \
+                                          sizeof(*new_raw)),                   \
+                     "USE2", old_ref)
+
+// Reborrow of kind from an existing reference, which may be the new reference
+// itself.
+bool sb_reborrow_from_ref(void **new_ref, void **old_ref, sb_kind_t kind,
+                          size_t size) {
+  sb_id_t used_id = sb_id_map_get_ptr(old_ref);
+  sb_stacks_t stacks = sb_stacks_get(*old_ref, size);
+  sb_id_t new_id = (kind == SB_SHARED_RW) ? __sb_id_bottom : sb_id_fresh();
+  sb_id_map_set_ptr(new_ref, new_id);
+  return sb_stacks_reborrow(stacks, used_id, kind, new_id);
+}
+
+#ifdef SB_NATIVE
+// From here on the program allocates through sb_native.h, so that NEW_DYNAMIC
+// finds the size of its heap objects. The model itself keeps the C library.
+#define malloc(size) sb_native_malloc(size)
+#define calloc(n, size) sb_native_calloc(n, size)
+#define realloc(ptr, size) sb_native_realloc(ptr, size)
+#define free(ptr) sb_native_free(ptr)
+#endif
+
 #endif
@@ -6,13 +6,18 @@
 
 /*
   This model uses:
-  - 1 shadow map to associate tag values with memory locations used to store pointer values.
-  - a single borrow stack tracking a single memory location that is picked non-deterministically.
+  - 1 shadow map to associate tag values with memory locations used to store pointer values,
+    or with -DSB_TAG_TABLE a small table holding the tags of the memory
+    locations that point to or are a tracked location.
+  - SB_DEMONIC_K borrow stacks, each tracking a single memory location that is
+    picked non-deterministically.
 */
 
 // analyse with --slice-formula and minisat
 // remoarks
+#ifndef SB_TAG_TABLE
 #include "shadow_map_mult.h"
+#endif
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -21,6 +26,13 @@
 // use symbolic sizes for maps and stacks
 bool SB_SYMSIZE = true;
 
+// -DSB_FORCE_SYMSIZE=0 or 1 overrides the symbolic_size argument of SB_INIT
+#ifdef SB_FORCE_SYMSIZE
+#define SB_SYMSIZE_ARG(symbolic_size) SB_FORCE_SYMSIZE
+#else
+#define SB_SYMSIZE_ARG(symbolic_size) (symbolic_size)
+#endif
+
 // maximum stack size
 size_t SB_MAX_STACK_SIZE = 32;
 
@@ -35,23 +47,8 @@ const sb_kind_t SB_SHARED_RW = 0x4;
 // disabled &mut x
 const sb_kind_t SB_DISABLED = 0x4;
 
-// Borrow ID type
-// We track at most 128 borrows in the program
-typedef int8_t sb_id_t;
-
-// Borrow ID used for raw pointers
-const sb_id_t __sb_id_bottom = -1;
-
-// Generates a stream of unique borrow IDs
-sb_id_t __sb_id_fresh = 0;
-
-// Returns a fresh borrow ID
-sb_id_t sb_id_fresh() {
-  assert(__sb_id_fresh < UINT16_MAX);
-  sb_id_t res = __sb_id_fresh;
-  __sb_id_fresh++;
-  return res;
-}
+// Borrow IDs, shared with stacked_borrows.h
+#include "sb_tags.h"
 
 // Representation of a borrow stack item
 typedef struct {
@@ -61,7 +58,7 @@ typedef struct {
 
 // A stack of borrow items
 typedef struct {
-  // address of the location being tracked
+  // address of the tracked location, or object, the stack belongs to
   uint8_t *ptr;
   // Index of the next free slot in elems
   int8_t top;
@@ -104,12 +101,184 @@ void sb_stack_push(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
 
 int8_t sb_stack_find(sb_stack_t *stack, sb_kind_t kind, sb_id_t id) {
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
-    if (stack->elems[i].kind == kind & stack->elems[i].id == id)
+    if (stack->elems[i].kind == kind && stack->elems[i].id == id)
       return i;
   }
   return -1;
 }
 
+// Number of memory locations tracked at the same time. Compiling with
+// -DSB_DEMONIC_K=<k> lets a violation that needs several locations to be
+// tracked together be found by a single choice, at the cost of k stacks.
+#ifndef SB_DEMONIC_K
+#define SB_DEMONIC_K 1
+#endif
+
+#ifdef SB_DEMONIC_OBJECT
+// Compiling with -DSB_DEMONIC_OBJECT tracks whole objects instead of exact
+// addresses: a tracked object has a stack per byte, so that borrows of its
+// fields or cells are related to each other and to borrows of the object.
+// The stack of a byte is created on first use, holding the item of the
+// owner of the object.
+
+// A tracked object
+typedef struct {
+  // first byte of the object, NULL if no object is tracked
+  uint8_t *ptr;
+  // nof bytes of the object
+  size_t size;
+  // tag of the owner of the object
+  sb_id_t id;
+  // borrow stack of each byte, NULL until first used
+  sb_stack_t **stacks;
+} sb_object_t;
+
+// The tracked objects
+sb_object_t __sb_objects[SB_DEMONIC_K];
+
+// Initialises the tracked objects, initially no object is tracked
+void sb_stack_map_init() {
+  for (size_t i = 0; i < SB_DEMONIC_K; i++)
+    __sb_objects[i].ptr = NULL;
+}
+
+// Returns the tracked object that ptr points into, NULL if there is none
+sb_object_t *sb_object_get(void *ptr) {
+  for (size_t i = 0; i < SB_DEMONIC_K; i++) {
+    if (__sb_objects[i].ptr && __CPROVER_same_object(__sb_objects[i].ptr, ptr))
+      return &__sb_objects[i];
+  }
+  return NULL;
+}
+
+// Gets the borrow stack associated with the memory location pointed to by ptr,
+// NULL if that location is not tracked.
+sb_stack_t *sb_stack_get(void *ptr) {
+  sb_object_t *object = sb_object_get(ptr);
+  if (!object)
+    return NULL;
+  size_t offset =
+      __CPROVER_POINTER_OFFSET(ptr) - __CPROVER_POINTER_OFFSET(object->ptr);
+  if (offset >= object->size)
+    return NULL;
+  sb_stack_t *stack = object->stacks[offset];
+  if (!stack) {
+    stack = sb_stack_create();
+    stack->ptr = object->ptr;
+    sb_stack_push(stack, SB_UNIQUE, object->id);
+    object->stacks[offset] = stack;
+  }
+  return stack;
+}
+
+// The tag of a local is held by the first byte of the local, so that it also
+// applies to the fields or cells of the local.
+void *sb_local_owner(void *address_of_local) {
+  sb_object_t *object = sb_object_get(address_of_local);
+  return object ? object->ptr : address_of_local;
+}
+#else
+// The borrow stacks of the tracked locations
+sb_stack_t *__sb_stacks[SB_DEMONIC_K];
+
+// Initialises the tracked stacks, initially no location is tracked
+void sb_stack_map_init() {
+  for (size_t i = 0; i < SB_DEMONIC_K; i++)
+    __sb_stacks[i] = sb_stack_create();
+}
+
+// Gets the borrow stack associated with the memory location pointed to by ptr,
+// NULL if that location is not tracked.
+sb_stack_t *sb_stack_get(void *ptr) {
+  for (size_t i = 0; i < SB_DEMONIC_K; i++) {
+    if (__sb_stacks[i]->ptr == ptr)
+      return __sb_stacks[i];
+  }
+  return NULL;
+}
+
+#define sb_local_owner(address_of_local) (address_of_local)
+#endif
+
+#ifdef SB_TAG_TABLE
+// Only the locations that point to or are a tracked location ever receive a
+// tag, so instead of a shadow map the tags are kept in a table of at most
+// SB_TAG_TABLE_SIZE entries keyed by the address of the location. Each entry
+// remembers the tracked location it relates to and is dropped when that
+// location stops being tracked. The formula no longer depends on the number
+// of objects of the program.
+
+#ifndef SB_TAG_TABLE_SIZE
+#define SB_TAG_TABLE_SIZE 8
+#endif
+
+typedef struct {
+  // address of the location holding the tag, NULL for a free entry
+  void *addr;
+  // the tag
+  sb_id_t id;
+  // tracked location, or object, the tag relates to
+  void *location;
+} sb_tag_entry_t;
+
+sb_tag_entry_t __sb_tag_table[SB_TAG_TABLE_SIZE];
+
+void sb_id_map_init() {
+  for (size_t i = 0; i < SB_TAG_TABLE_SIZE; i++)
+    __sb_tag_table[i].addr = NULL;
+}
+
+// Frees the entries related to the given tracked location
+void sb_id_map_forget(void *location) {
+  for (size_t i = 0; i < SB_TAG_TABLE_SIZE; i++) {
+    if (__sb_tag_table[i].location == location)
+      __sb_tag_table[i].addr = NULL;
+  }
+}
+
+void sb_id_map_set(sb_stack_t *stack, void *addr, sb_id_t id) {
+  size_t slot = SB_TAG_TABLE_SIZE;
+  for (size_t i = 0; i < SB_TAG_TABLE_SIZE; i++) {
+    if (__sb_tag_table[i].addr == addr) {
+      slot = i;
+      break;
+    }
+    if (slot == SB_TAG_TABLE_SIZE && __sb_tag_table[i].addr == NULL)
+      slot = i;
+  }
+  __CPROVER_assert(slot < SB_TAG_TABLE_SIZE,
+                   "no more than SB_TAG_TABLE_SIZE tagged locations");
+  __sb_tag_table[slot] =
+      (sb_tag_entry_t){.addr = addr, .id = id, .location = stack->ptr};
+}
+
+// Locations that hold no tag read as the null tag like in the shadow map
+sb_id_t sb_id_map_get(void *addr) {
+  for (size_t i = 0; i < SB_TAG_TABLE_SIZE; i++) {
+    if (__sb_tag_table[i].addr == addr)
+      return __sb_tag_table[i].id;
+  }
+  return __sb_id_null;
+}
+
+void sb_id_map_set_ptr(sb_stack_t *stack, void **ptr_to_ptr, sb_id_t id) {
+  sb_id_map_set(stack, ptr_to_ptr, id);
+}
+
+void sb_id_map_set_local(sb_stack_t *stack, void *address_of_local,
+                         sb_id_t id) {
+  sb_id_map_set(stack, address_of_local, id);
+}
+
+sb_id_t sb_id_map_get_ptr(void **ptr_to_ptr) {
+  return sb_id_map_get(ptr_to_ptr);
+}
+
+sb_id_t sb_id_map_get_local(void *address_of_local) {
+  return sb_id_map_get(sb_local_owner(address_of_local));
+}
+
+#else
 // shadow map that associates a borrow ID to each pointer variable of the
 // program The borrow ID is stored under the object ID of the memory location
 // that contains the pointer variable.
@@ -117,11 +286,12 @@ shadow_map_t __sb_id_map;
 
 void sb_id_map_init() { shadow_map_init(&__sb_id_map, sizeof(sb_id_t)); }
 
-void sb_id_map_set_ptr(void **ptr_to_ptr, sb_id_t id) {
+void sb_id_map_set_ptr(sb_stack_t *stack, void **ptr_to_ptr, sb_id_t id) {
   *(sb_id_t *)shadow_map_get(&__sb_id_map, ptr_to_ptr) = id;
 }
 
-void sb_id_map_set_local(void *address_of_local, sb_id_t id) {
+void sb_id_map_set_local(sb_stack_t *stack, void *address_of_local,
+                         sb_id_t id) {
   *(sb_id_t *)shadow_map_get(&__sb_id_map, address_of_local) = id;
 }
 
@@ -130,62 +300,101 @@ sb_id_t sb_id_map_get_ptr(void **ptr_to_ptr) {
 }
 
 sb_id_t sb_id_map_get_local(void *address_of_local) {
-  return *(sb_id_t *)shadow_map_get(&__sb_id_map, address_of_local);
+  return *(sb_id_t *)shadow_map_get(&__sb_id_map,
+                                    sb_local_owner(address_of_local));
 }
 
-// Shadow memory that associates pointers with borrow stacks
-sb_stack_t *__sb_stack = NULL;
+// Tags stay in the shadow map when their location stops being tracked
+void sb_id_map_forget(void *location) {}
+#endif
 
-// Initialises a shadow map of stack pointers
-void sb_stack_map_init() {
-  __sb_stack =  sb_stack_create();
+#ifdef SB_DEMONIC_OBJECT
+// Starts tracking the object of size bytes pointed to by ptr, owned by the
+// tag id, and returns the stack of its first byte. The tracked object that
+// ptr points into is replaced, otherwise a nondeterministically chosen one.
+sb_stack_t *sb_stack_track(void *ptr, size_t size, sb_id_t id) {
+  sb_object_t *object = sb_object_get(ptr);
+  if (!object) {
+    size_t i = nondet_size_t();
+    __CPROVER_assume(i < SB_DEMONIC_K);
+    object = &__sb_objects[i];
+  }
+  sb_id_map_forget(object->ptr);
+  *object = (sb_object_t){
+      .ptr = ptr,
+      .size = size,
+      .id = id,
+      .stacks = __CPROVER_allocate(size * sizeof(sb_stack_t *), 1)};
+  return sb_stack_get(ptr);
 }
-
-// Gets the borrow stack associated with the memory location pointed to by ptr.
-sb_stack_t *sb_stack_get(void *ptr) {
-  return __sb_stack->ptr == ptr ? __sb_stack : NULL;
+#else
+// Starts tracking the memory location pointed to by ptr, owned by the tag id,
+// and returns its stack. The stack already tracking ptr is reused, otherwise
+// a nondeterministically chosen stack stops tracking its location.
+sb_stack_t *sb_stack_track(void *ptr, size_t size, sb_id_t id) {
+  sb_stack_t *stack = sb_stack_get(ptr);
+  if (!stack) {
+    size_t i = nondet_size_t();
+    __CPROVER_assume(i < SB_DEMONIC_K);
+    stack = __sb_stacks[i];
+  }
+  sb_id_map_forget(stack->ptr);
+  stack->ptr = ptr;
+  stack->top = 0;
+  sb_stack_push(stack, SB_UNIQUE, id);
+  return stack;
 }
+#endif
 
 // initialise ghost state for stacked borrows
 #define SB_INIT(symbolic_size, max_stack_size)                                 \
   do {                                                                         \
-    SB_SYMSIZE = symbolic_size;                                                \
+    SB_SYMSIZE = SB_SYMSIZE_ARG(symbolic_size);                                \
+    __CPROVER_assert((max_stack_size) <= INT8_MAX,                             \
+                     "stack indices fit in int8_t");                           \
     SB_MAX_STACK_SIZE = max_stack_size;                                        \
     sb_id_map_init();                                                          \
     sb_stack_map_init();                                                       \
   } while (0)
 
+// All objects are tracked demonically, locals included
+#define SB_INIT_HYBRID(symbolic_size, max_stack_size)                          \
+  SB_INIT(symbolic_size, max_stack_size)
+
+// Tracked stacks are emptied when a new location gets tracked, dead tags are
+// not collected.
+#define STORAGE_DEAD(ptr)
+#define SB_GC()
+
 ////// stacked borrows rules from the paper //////
 
 // Initialises the borrow stack for a local object by creating the borrow stack
 // in the map and pushing a SB_UNIQUE on that stack. The local variable
 // owns itself and a direct write to the variable is treated like a write
 // through a mutable ref.
-#define NEW_LOCAL(local) sb_new_local(&local)
-void sb_new_local(void *ptr) {
+#define NEW_LOCAL(local) sb_new_local(&local, sizeof(local))
+void sb_new_local(void *ptr, size_t size) {
   // decide nondeterministically to track this location
   if (nondet_size_t())
     return;
   sb_id_t fresh_id = sb_id_fresh();
-  sb_id_map_set_local(ptr, fresh_id);
-  __sb_stack->ptr = ptr;
-  __sb_stack->top = 0;
-  sb_stack_push(__sb_stack, SB_UNIQUE, fresh_id);
+  sb_stack_t *stack = sb_stack_track(ptr, size, fresh_id);
+  sb_id_map_set_local(stack, ptr, fresh_id);
 }
 
 // Initialises the borrow stack for the dynamic object pointed to by
 // the pointer variable pointed to by ptr. Dynamic objects are anonymous
 // and can only be referred to throught the pointer variable that received
 // the fresh pointer value. That pointer variable uniquely owns the object.
-#define NEW_DYNAMIC(ptr) sb_new_dynamic(&ptr)
-void sb_new_dynamic(void **ptr) {
+#define NEW_DYNAMIC(ptr)                                                       \
+  sb_new_dynamic(&ptr,                                                         \
+                 __CPROVER_OBJECT_SIZE(ptr) - __CPROVER_POINTER_OFFSET(ptr))
+void sb_new_dynamic(void **ptr, size_t size) {
   if (nondet_size_t())
     return;
   sb_id_t fresh_id = sb_id_fresh();
-  sb_id_map_set_ptr(ptr, fresh_id);
-  __sb_stack->ptr = *ptr;
-  __sb_stack->top = 0;
-  sb_stack_push(__sb_stack, SB_UNIQUE, fresh_id);
+  sb_stack_t *stack = sb_stack_track(*ptr, size, fresh_id);
+  sb_id_map_set_ptr(stack, ptr, fresh_id);
 }
 
 #define UNIQUE_FROM_LOCAL(new_ref, local)                                      \
@@ -194,12 +403,13 @@ void sb_new_dynamic(void **ptr) {
 // Models the creation of a new mutable reference created from the address of a
 // local variable.
 void sb_new_mut_from_local(void **new_ref, void *local) {
-  if(__sb_stack->ptr != local)
+  sb_stack_t *stack = sb_stack_get(local);
+  if (!stack)
     return;
   sb_id_t old_id = sb_id_map_get_local(local);
   sb_id_t new_id = sb_id_fresh();
-  sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(__sb_stack, SB_UNIQUE, new_id);
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  sb_stack_push(stack, SB_UNIQUE, new_id);
 }
 
 #define UNIQUE_FROM_REF(new_ref, old_ref)                                      \
@@ -208,12 +418,13 @@ void sb_new_mut_from_local(void **new_ref, void *local) {
 // Models a new mutable reference created by borrowing an existing reference.
 // let &mut y = x;
 void sb_new_mut_from_ref(void **new_ref, void **old_ref) {
-  if(__sb_stack->ptr != *old_ref)
+  sb_stack_t *stack = sb_stack_get(*old_ref);
+  if (!stack)
     return;
   sb_id_t old_id = sb_id_map_get_ptr(old_ref);
   sb_id_t new_id = sb_id_fresh();
-  sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(*old_ref), SB_UNIQUE, new_id);
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  sb_stack_push(stack, SB_UNIQUE, new_id);
 }
 
 // USE-1 Rule from the paper. Triggered when a memory location is updated
@@ -235,9 +446,9 @@ void sb_new_mut_from_ref(void **new_ref, void **old_ref) {
   } while (0)
 
 bool sb_use1_local(void *used) {
-  if (__sb_stack->ptr != used)
+  sb_stack_t *stack = sb_stack_get(used);
+  if (!stack)
     return true;
-  sb_stack_t *stack = __sb_stack;
   sb_id_t used_id = sb_id_map_get_local(used);
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++)
   {
@@ -259,10 +470,10 @@ bool sb_use1_local(void *used) {
   } while (0)
 
 bool sb_use1(void **used) {
-  if (__sb_stack->ptr != *used)
+  sb_stack_t *stack = sb_stack_get(*used);
+  if (!stack)
     return true;
   sb_id_t used_id = sb_id_map_get_ptr(used);
-  sb_stack_t *stack = __sb_stack;
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
     if (stack->elems[i].id == used_id && stack->elems[i].kind == SB_UNIQUE) {
       stack->top = i + 1;
@@ -277,10 +488,11 @@ bool sb_use1(void **used) {
 
 // New raw pointer from the address of a local variable.
 void sb_new_raw_from_local(void **new_raw, void *local) {
-  if(__sb_stack->ptr != local)
+  sb_stack_t *stack = sb_stack_get(local);
+  if (!stack)
     return;
-  sb_id_map_set_ptr(new_raw, __sb_id_bottom);
-  sb_stack_push(__sb_stack, SB_SHARED_RW, __sb_id_bottom);
+  sb_id_map_set_ptr(stack, new_raw, __sb_id_bottom);
+  sb_stack_push(stack, SB_SHARED_RW, __sb_id_bottom);
 }
 
 #define SHARED_RW_FROM_REF(new_raw, old_ref)                                   \
@@ -288,10 +500,11 @@ void sb_new_raw_from_local(void **new_raw, void *local) {
 
 // New raw pointer from a reference.
 void sb_new_raw_from_ref(void **new_raw, void **old_ref) {
-  if(__sb_stack->ptr != *old_ref)
+  sb_stack_t *stack = sb_stack_get(*old_ref);
+  if (!stack)
     return;
-  sb_id_map_set_ptr(new_raw, __sb_id_bottom);
-  sb_stack_push(__sb_stack, SB_SHARED_RW, __sb_id_bottom);
+  sb_id_map_set_ptr(stack, new_raw, __sb_id_bottom);
+  sb_stack_push(stack, SB_SHARED_RW, __sb_id_bottom);
 }
 
 #define TRANSMUTE_REF(new_ref, old_ref) sb_transmute_ref(&new_ref, &old_ref)
@@ -299,9 +512,10 @@ void sb_new_raw_from_ref(void **new_raw, void **old_ref) {
 // Transmuting a ref to another ref copies the borrow id but does not modify
 // the stack.
 void sb_transmute_ref(void **new_ref, void **old_ref) {
-  if (__sb_stack->ptr != *old_ref)
+  sb_stack_t *stack = sb_stack_get(*old_ref);
+  if (!stack)
     return;
-  sb_id_map_set_ptr(new_ref, sb_id_map_get_ptr(old_ref));
+  sb_id_map_set_ptr(stack, new_ref, sb_id_map_get_ptr(old_ref));
 }
 
 // USE-2 Rule from the paper (replaces USE-1).
@@ -317,11 +531,11 @@ void sb_transmute_ref(void **new_ref, void **old_ref) {
   } while (0)
 
 bool sb_use2_local(void *used) {
-  if (__sb_stack->ptr != used)
+  sb_stack_t *stack = sb_stack_get(used);
+  if (!stack)
     return true;
   sb_id_t used_id = sb_id_map_get_local(used);
   sb_kind_t kind = (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
-  sb_stack_t *stack = __sb_stack;
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
     if (stack->elems[i].id == used_id && stack->elems[i].kind == kind) {
       stack->top = i + 1;
@@ -340,11 +554,11 @@ bool sb_use2_local(void *used) {
   } while (0)
 
 bool sb_use2(void **used) {
-  if (__sb_stack->ptr != *used)
+  sb_stack_t *stack = sb_stack_get(*used);
+  if (!stack)
     return true;
   sb_id_t used_id = sb_id_map_get_ptr(used);
   sb_kind_t kind = (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
-  sb_stack_t *stack = __sb_stack;
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
     if (stack->elems[i].id == used_id && stack->elems[i].kind == kind) {
       stack->top = i + 1;
@@ -359,11 +573,12 @@ bool sb_use2(void **used) {
 
 // New mutable reference created from the address of a stack variable.
 void sb_new_shared_from_local(void **new_ref, void *local) {
-  if (__sb_stack->ptr != local)
+  sb_stack_t *stack = sb_stack_get(local);
+  if (!stack)
     return;
   sb_id_t new_id = sb_id_fresh();
-  sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(local), SB_SHARED_RO, new_id);
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  sb_stack_push(stack, SB_SHARED_RO, new_id);
 }
 
 #define SHARED_RO_FROM_REF(new_ref, old_ref)                                   \
@@ -371,11 +586,12 @@ void sb_new_shared_from_local(void **new_ref, void *local) {
 
 // New mutable reference created by copying an existing reference.
 void sb_new_shared_from_ref(void **new_ref, void **old_ref) {
-  if (__sb_stack->ptr != *old_ref)
+  sb_stack_t *stack = sb_stack_get(*old_ref);
+  if (!stack)
     return;
   sb_id_t new_id = sb_id_fresh();
-  sb_id_map_set_ptr(new_ref, new_id);
-  sb_stack_push(sb_stack_get(*old_ref), SB_SHARED_RO, new_id);
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  sb_stack_push(stack, SB_SHARED_RO, new_id);
 }
 
 // READ-1 Rule from the paper. Check that the used borrow id in the stack
@@ -393,10 +609,10 @@ void sb_new_shared_from_ref(void **new_ref, void **old_ref) {
   } while (0)
 
 bool sb_read1_local(void *used) {
-  if (__sb_stack->ptr != used)
+  sb_stack_t *stack = sb_stack_get(used);
+  if (!stack)
     return true;
   sb_id_t used_id = sb_id_map_get_local(used);
-  sb_stack_t *stack = __sb_stack;
   bool found = false;
   int8_t new_top = -1;
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
@@ -425,10 +641,10 @@ bool sb_read1_local(void *used) {
   } while (0)
 
 bool sb_read1(void **used) {
-  if (__sb_stack->ptr != *used)
+  sb_stack_t *stack = sb_stack_get(*used);
+  if (!stack)
     return true;
   sb_id_t used_id = sb_id_map_get_ptr(used);
-  sb_stack_t *stack = __sb_stack;
   bool found = false;
   int8_t new_top = -1;
   for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
@@ -448,4 +664,93 @@ bool sb_read1(void **used) {
   return found;
 }
 
+////// fused reborrows //////
+
+// REBORROW_MUT(y, x) is USE2(x); UNIQUE_FROM_REF(y, x);, REBORROW_SHARED(y, x)
+// is READ1(x); SHARED_RO_FROM_REF(y, x); and REBORROW_RAW(y, x) is USE2(x);
+// SHARED_RW_FROM_REF(y, x);, with a single lookup of the tag and of the stack
+// and a single pass over the stack. The _LOCAL variants borrow a local.
+
+#define SB_REBORROW_ASSERT(result, rule, used)                                 \
+  do {                                                                         \
+    bool __sb_result = (result);                                               \
+    __CPROVER_assert(__sb_result, rule " " #used);                             \
+    if (!__sb_result)                                                          \
+      __CPROVER_assume(false);                                                 \
+  } while (0)
+
+// Reborrow of kind through used_id: READ-1 for a shared reference, USE-2
+// otherwise, then a push of (kind, new_id) right above the new top.
+bool sb_stack_reborrow(sb_stack_t *stack, sb_id_t used_id, sb_kind_t kind,
+                       sb_id_t new_id) {
+  bool read = kind == SB_SHARED_RO;
+  sb_kind_t used_kind = (used_id == __sb_id_bottom) ? SB_SHARED_RW : SB_UNIQUE;
+  bool found = false;
+  int8_t new_top = -1;
+  for (int8_t i = 0; (i < SB_MAX_STACK_SIZE) && (i < stack->top); i++) {
+    if (!found) {
+      found = stack->elems[i].id == used_id &&
+              (read || stack->elems[i].kind == used_kind);
+      new_top = i;
+    } else if (read && stack->elems[i].kind == SB_SHARED_RO) {
+      new_top = i;
+    } else {
+      break;
+    }
+  }
+  if (!found)
+    return false;
+  assert(new_top + 1 < SB_MAX_STACK_SIZE);
+  stack->elems[new_top + 1] = (sb_item_t){.kind = kind, .id = new_id};
+  stack->top = new_top + 2;
+  return true;
+}
+
+#define REBORROW_MUT_LOCAL(new_ref, local)                                     \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local(&new_ref, &local, SB_UNIQUE),      \
+                     "USE2", local)
+
+#define REBORROW_SHARED_LOCAL(new_ref, local)                                  \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local(&new_ref, &local, SB_SHARED_RO),   \
+                     "READ1", local)
+
+#define REBORROW_RAW_LOCAL(new_raw, local)                                     \
+  SB_REBORROW_ASSERT(sb_reborrow_from_local(&new_raw, &local, SB_SHARED_RW),   \
+                     "USE2", local)
+
+// Reborrow of kind from the address of a local variable.
+bool sb_reborrow_from_local(void **new_ref, void *local, sb_kind_t kind) {
+  sb_stack_t *stack = sb_stack_get(local);
+  if (!stack)
+    return true;
+  sb_id_t used_id = sb_id_map_get_local(local);
+  sb_id_t new_id = (kind == SB_SHARED_RW) ? __sb_id_bottom : sb_id_fresh();
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  return sb_stack_reborrow(stack, used_id, kind, new_id);
+}
+
+#define REBORROW_MUT(new_ref, old_ref)                                         \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref(&new_ref, &old_ref, SB_UNIQUE),      \
+                     "USE2", old_ref)
+
+#define REBORROW_SHARED(new_ref, old_ref)                                      \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref(&new_ref, &old_ref, SB_SHARED_RO),   \
+                     "READ1", old_ref)
+
+#define REBORROW_RAW(new_raw, old_ref)                                         \
+  SB_REBORROW_ASSERT(sb_reborrow_from_ref(&new_raw, &old_ref, SB_SHARED_RW),   \
+                     "USE2", old_ref)
+
+// Reborrow of kind from an existing reference, which may be the new reference
+// itself.
+bool sb_reborrow_from_ref(void **new_ref, void **old_ref, sb_kind_t kind) {
+  sb_stack_t *stack = sb_stack_get(*old_ref);
+  if (!stack)
+    return true;
+  sb_id_t used_id = sb_id_map_get_ptr(old_ref);
+  sb_id_t new_id = (kind == SB_SHARED_RW) ? __sb_id_bottom : sb_id_fresh();
+  sb_id_map_set_ptr(stack, new_ref, new_id);
+  return sb_stack_reborrow(stack, used_id, kind, new_id);
+}
+
 #endif
@@ -0,0 +1,40 @@
+#ifdef DEMONIC
+#include "stacked_borrows_demonic.h"
+#else
+#include "stacked_borrows.h"
+#endif
+
+struct pair {
+  int32_t a;
+  int32_t b;
+};
+
+/// borrows of a field of a local struct, only related to each other when the
+/// whole struct is tracked (-DSB_RANGE_STACKS, -DDEMONIC -DSB_DEMONIC_OBJECT)
+int main() {
+  SB_INIT(true, 16);
+
+  // let mut s = Pair { a: 1, b: 2 };
+  struct pair s = {1, 2};
+  NEW_LOCAL(s);
+
+  // let x = &mut s.b;
+  USE2_LOCAL(s.b);
+  int32_t *x = &s.b;
+  UNIQUE_FROM_LOCAL(x, s.b);
+
+  // let y = &mut s.b;
+  USE2_LOCAL(s.b); // pops x
+  int32_t *y = &s.b;
+  UNIQUE_FROM_LOCAL(y, s.b);
+
+  // *x = 3;
+  USE2(x); // fail
+  *x = 3;
+
+  // *y = 4;
+  USE2(y);
+  *y = 4;
+
+  return 0;
+}